@@ -0,0 +1,386 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:12:20 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 16:12:20 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+/**
+ * Microbenchmarks for the per-packet path: `make bench && ./ft_ping_bench`.
+ * Every case runs a calibrated batch of operations; after a warmup, the
+ * batch is repeated BENCH_REPS times and the median and best batch are
+ * reported per operation. cycles/op reads the TSC (reference cycles, not
+ * core cycles under frequency scaling), "-" where there is none.
+ */
+# define BENCH_REPS 15
+# define BENCH_WARMUP_NS 50000000LL	// 50 ms of warmup per case
+# define BENCH_BATCH_NS 2000000LL	// each repetition lasts at least 2 ms
+# define BENCH_INDICES 4096
+
+typedef struct s_bench
+{
+	const char	*name;
+	void		(*run)(size_t iters);
+	bool		sized;		// run once per payload size
+}	t_bench;
+
+t_ft_ping			*g_ft_ping = NULL;
+static t_ft_ping	g_app;
+static int			g_payload_size;
+static uint8_t		g_packet[RECV_BUFFER_SIZE];	// IP + ICMP echo reply
+static uint32_t		g_indices[BENCH_INDICES];
+static volatile uint64_t	g_sink;		// keeps results alive
+static t_transport	g_pcap_transport;	// simnet behind a --pcap writer
+
+static const int	g_sizes[] = {16, 56, 512, 1472, 8192};
+
+/* The hot path ends up here on fatal errors, nothing to clean */
+void	clean_up(void)
+{
+}
+
+void	interrupt(int signum)
+{
+	(void)signum;
+}
+
+void	request_dump(int signum)
+{
+	(void)signum;
+}
+
+static uint64_t	now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static uint64_t	now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__rdtsc());
+#else
+	return (0);
+#endif
+}
+
+/* Echo reply from 127.0.0.1 to target 0, as receive_packet would leave it */
+static void	build_packet(int payload_size)
+{
+	t_ip_header		*ip;
+	t_icmp_header	*icmp;
+	struct timeval	stamp;
+
+	memset(g_packet, 0, sizeof(g_packet));
+	ip = (t_ip_header *)g_packet;
+	ip->version = 4;
+	ip->ihl = 5;
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_ICMP;
+	ip->tot_len = htons(20 + ICMP_HEADER_SIZE + payload_size);
+	ip->saddr = htonl(INADDR_LOOPBACK);
+	ip->daddr = htonl(INADDR_LOOPBACK);
+	icmp = (t_icmp_header *)(g_packet + 20);
+	icmp->type = ICMP_ECHOREPLY;
+	icmp->un.echo.id = htons(g_app.targets[0].id);
+	gettimeofday(&stamp, NULL);
+	memcpy((uint8_t *)icmp + ICMP_HEADER_SIZE, &stamp, sizeof(stamp));
+	memset((uint8_t *)icmp + ICMP_HEADER_SIZE + sizeof(stamp), 0x42,
+		payload_size - sizeof(stamp));
+	icmp->checksum = calculate_checksum((uint16_t *)icmp,
+			ICMP_HEADER_SIZE + payload_size);
+	memcpy(g_app.recvbuffer, g_packet, 20 + ICMP_HEADER_SIZE + payload_size);
+	g_app.packet_size = ICMP_HEADER_SIZE + payload_size;
+}
+
+static void	bench_calculate_checksum(size_t iters)
+{
+	uint64_t	sum;
+
+	sum = 0;
+	while (iters--)
+		sum += calculate_checksum((uint16_t *)(g_packet + 20),
+				g_app.packet_size);
+	g_sink = sum;
+}
+
+static void	bench_verify_checksum(size_t iters)
+{
+	uint64_t	sum;
+
+	sum = 0;
+	while (iters--)
+		sum += verify_checksum((uint16_t *)(g_packet + 20), g_app.packet_size);
+	g_sink = sum;
+}
+
+static void	bench_prepare_echo(size_t iters)
+{
+	uint8_t	payload[MAX_PAYLOAD_SIZE];
+
+	prepare_payload(payload, g_payload_size, NULL);
+	while (iters--)
+		prepare_echo_request_packet(payload, g_app.sendbuffer,
+			(uint16_t)iters, g_app.targets[0].id);
+	g_sink = g_app.sendbuffer[2];
+}
+
+static void	bench_packet_parse(size_t iters)
+{
+	t_packet	pkt;
+	uint64_t	sum;
+
+	sum = 0;
+	while (iters--)
+		if (packet_parse(g_packet, 20 + g_app.packet_size, &pkt))
+			sum += pkt.seq;
+	g_sink = sum;
+}
+
+/* Echoed payload against what was sent, all of it matching (the worst case) */
+static void	bench_payload_check(size_t iters)
+{
+	t_packet	pkt;
+	uint64_t	sum;
+
+	packet_parse(g_packet, 20 + g_app.packet_size, &pkt);
+	sum = 0;
+	while (iters--)
+		sum += payload_check(&g_app, &pkt);
+	g_sink = sum;
+}
+
+/* Whole reception path of an echo reply in quiet mode: parse, checksum,
+matching, duplicate bitmap, stats. The bit is cleared so every call is a
+first reply */
+static void	bench_process_packet(size_t iters)
+{
+	t_target	*target;
+	t_packet	pkt;
+	int			bytes;
+
+	target = &g_app.targets[0];
+	target->sequence = 0; // the reply is for sequence 0, inside the window
+	bytes = 20 + g_app.packet_size;
+	while (iters--)
+	{
+		bitmap_clear(target->rcv_map, 0);
+		if (packet_parse(g_app.recvbuffer, bytes, &pkt))
+			process_packet(&g_app, &pkt);
+	}
+	g_sink = target->rcv_packets;
+}
+
+/* Engine round trip over the simulated network (zero delay): build and send
+an echo request, get the reply back and run it through process_packet */
+static void	bench_simnet_roundtrip(size_t iters)
+{
+	t_target	*target;
+	t_packet	pkt;
+	int			bytes;
+
+	target = &g_app.targets[0];
+	while (iters--)
+	{
+		send_echo(&g_app, target);
+		bytes = receive_packet(&g_app.transport, g_app.recvbuffer,
+				sizeof(g_app.recvbuffer), &g_app.reply_addr, &g_app.end);
+		if (!packet_parse(g_app.recvbuffer, bytes, &pkt))
+			continue ;
+		bitmap_clear(target->rcv_map, pkt.seq & (g_app.dup_window - 1));
+		process_packet(&g_app, &pkt);
+	}
+	g_sink = target->rcv_packets;
+}
+
+/* Same round trip with --pcap recording both packets (to /dev/null) */
+static void	bench_simnet_pcap_roundtrip(size_t iters)
+{
+	t_transport	plain;
+
+	plain = g_app.transport;
+	g_app.transport = g_pcap_transport;
+	bench_simnet_roundtrip(iters);
+	g_pcap_transport = g_app.transport;
+	g_app.transport = plain;
+}
+
+static void	bench_bitmap(size_t iters)
+{
+	uint8_t		map[65536 / 8];
+	uint64_t	sum;
+	size_t		i;
+
+	memset(map, 0, sizeof(map));
+	sum = 0;
+	for (i = 0; i < iters; i++)
+	{
+		bitmap_set(map, g_indices[i % BENCH_INDICES]);
+		sum += bitmap_test(map, g_indices[(i + 7) % BENCH_INDICES]);
+	}
+	g_sink = sum;
+}
+
+static void	bench_update_stats(size_t iters)
+{
+	t_target	*target;
+	size_t		i;
+
+	target = &g_app.targets[0];
+	for (i = 0; i < iters; i++)
+	{
+		target->rcv_packets++;
+		update_stats(target, 100 + g_indices[i % BENCH_INDICES] % 900);
+	}
+	g_sink = target->stats[AVG];
+}
+
+static const t_bench	g_benches[] = {
+	{"calculate_checksum", bench_calculate_checksum, true},
+	{"verify_checksum", bench_verify_checksum, true},
+	{"prepare_echo_request_packet", bench_prepare_echo, true},
+	{"packet_parse", bench_packet_parse, true},
+	{"payload_check", bench_payload_check, true},
+	{"process_packet", bench_process_packet, true},
+	{"simnet_roundtrip", bench_simnet_roundtrip, true},
+	{"simnet_roundtrip+pcap", bench_simnet_pcap_roundtrip, true},
+	{"bitmap_set+test", bench_bitmap, false},
+	{"update_stats", bench_update_stats, false},
+};
+
+static int	cmp_double(const void *a, const void *b)
+{
+	double	x;
+	double	y;
+
+	x = *(const double *)a;
+	y = *(const double *)b;
+	return ((x > y) - (x < y));
+}
+
+/* Grows the batch during warmup until one batch lasts BENCH_BATCH_NS */
+static size_t	calibrate(const t_bench *bench)
+{
+	size_t		iters;
+	uint64_t	start;
+	uint64_t	elapsed;
+	uint64_t	warm_end;
+
+	iters = 1;
+	warm_end = now_ns() + BENCH_WARMUP_NS;
+	while (1)
+	{
+		start = now_ns();
+		bench->run(iters);
+		elapsed = now_ns() - start;
+		if (elapsed >= BENCH_BATCH_NS && start >= warm_end)
+			return (iters);
+		if (elapsed < BENCH_BATCH_NS)
+			iters *= 2;
+	}
+}
+
+static void	run_bench(const t_bench *bench, int size)
+{
+	double		ns[BENCH_REPS];
+	double		cycles[BENCH_REPS];
+	size_t		iters;
+	uint64_t	t0;
+	uint64_t	c0;
+	int			i;
+
+	iters = calibrate(bench);
+	for (i = 0; i < BENCH_REPS; i++)
+	{
+		t0 = now_ns();
+		c0 = now_cycles();
+		bench->run(iters);
+		cycles[i] = (double)(now_cycles() - c0) / iters;
+		ns[i] = (double)(now_ns() - t0) / iters;
+	}
+	qsort(ns, BENCH_REPS, sizeof(double), cmp_double);
+	qsort(cycles, BENCH_REPS, sizeof(double), cmp_double);
+	if (size)
+		printf("%-28s %6d", bench->name, size);
+	else
+		printf("%-28s %6s", bench->name, "-");
+	printf(" %10.1f %10.1f", ns[BENCH_REPS / 2], ns[0]);
+	if (cycles[0] > 0)
+		printf(" %10.1f %10.1f\n", cycles[BENCH_REPS / 2], cycles[0]);
+	else
+		printf(" %10s %10s\n", "-", "-");
+}
+
+static void	init_bench(void)
+{
+	static char		*hostnames[] = {"localhost"};
+	t_target		*target;
+	size_t			i;
+
+	memset(&g_app, 0, sizeof(g_app));
+	g_app.pid = getpid();
+	g_app.transport.fd = -1;
+	g_app.options[QUIET] = 1;
+	g_app.options[INTERVAL] = INTERVAL_MS;
+	g_app.options[PERCENTILES] = 1;
+	g_app.hostnames = hostnames;
+	g_app.target_count = 1;
+	payload_fill(&g_app);
+	targets_init(&g_app);
+	target = &g_app.targets[0];
+	target->state = TARGET_READY;
+	target->dest_addr.sin_family = AF_INET;
+	target->dest_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	gettimeofday(&g_app.end, NULL);
+	simnet_init(&g_app.transport, "", false);
+	simnet_init(&g_pcap_transport, "", false);
+	pcap_attach(&g_pcap_transport, "/dev/null", 0);
+	g_ft_ping = &g_app;
+	srandom(42);
+	for (i = 0; i < BENCH_INDICES; i++)
+		g_indices[i] = random() & UINT16_MAX;
+}
+
+int	main(int ac, char **av)
+{
+	size_t	i;
+	size_t	s;
+
+	init_bench();
+	printf("%-28s %6s %10s %10s %10s %10s\n", "BENCHMARK", "SIZE",
+		"NS/OP", "BEST", "CYCLES/OP", "BEST");
+	for (i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++)
+	{
+		// Optional filter: ./ft_ping_bench checksum
+		if (ac > 1 && !strstr(g_benches[i].name, av[1]))
+			continue ;
+		if (!g_benches[i].sized)
+		{
+			build_packet(PAYLOAD_SIZE);
+			run_bench(&g_benches[i], 0);
+			continue ;
+		}
+		for (s = 0; s < sizeof(g_sizes) / sizeof(g_sizes[0]); s++)
+		{
+			g_payload_size = g_sizes[s];
+			build_packet(g_payload_size);
+			run_bench(&g_benches[i], g_payload_size);
+		}
+	}
+	g_app.transport.close(&g_app.transport);
+	g_pcap_transport.close(&g_pcap_transport);
+	return (0);
+}
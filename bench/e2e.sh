@@ -0,0 +1,218 @@
+#!/bin/bash
+# **************************************************************************** #
+#                                                                              #
+#    e2e.sh - end-to-end throughput and latency benchmark of ./ft_ping         #
+#                                                                              #
+#    Runs ft_ping against 127.0.0.1, against the far end of a veth pair in     #
+#    a throwaway network namespace when `ip netns` works, and against          #
+#    ./ft_ping_responder (make responder) when it is built, over every         #
+#    combination of output mode and payload size. One JSON object per run is   #
+#    written to the report (JSON lines), for comparing builds:                 #
+#                                                                              #
+#        sudo bench/e2e.sh -o before.jsonl                                     #
+#        sudo bench/e2e.sh -o after.jsonl                                      #
+#        bench/e2e.sh -c before.jsonl after.jsonl                              #
+#                                                                              #
+# **************************************************************************** #
+
+set -u
+
+BIN=./ft_ping
+RESPONDER=./ft_ping_responder
+RESPONDER_SPEC=
+DURATION=3
+REPORT=bench_e2e.jsonl
+SIZES="56 1472 8192"
+MODES="interval quiet flood flood-quiet preload window"
+NS=ftping-bench-$$
+VETH_LOCAL=10.254.0.1
+VETH_PEER=10.254.0.2
+NS_TUN=ftping-tun-$$
+TUN_PEER=10.255.0.2
+RESPONDER_PID=
+
+usage()
+{
+	echo "Usage: sudo $0 [-d SECONDS] [-o REPORT] [-s \"SIZES\"] [-m \"MODES\"] [-b BINARY] [-r RESPONDER_SPEC]"
+	echo "       $0 -c OLD_REPORT NEW_REPORT"
+	echo "Modes: $MODES"
+}
+
+# Side by side pps, p50 RTT and CPU per packet of two reports
+compare()
+{
+	jq -n -r --slurpfile a "$1" --slurpfile b "$2" '
+		def key: "\(.target) \(.mode) \(.size)";
+		def pct(x; y): if x > 0 and y != null then "\((y - x) * 100 / x | floor)%" else "-" end;
+		($a | map({key: key, value: .}) | from_entries) as $old
+		| ["TARGET", "MODE", "SIZE", "PPS", "dPPS", "P50_MS", "dP50", "CPU_US/PKT", "dCPU"],
+		  ($b[] | . as $n | $old[key] as $o | select($o != null)
+			| [$n.target, $n.mode, $n.size,
+			   $n.pps, pct($o.pps; $n.pps),
+			   ($n.rtt_p50_ms // $n.rtt_avg_ms), pct($o.rtt_p50_ms // $o.rtt_avg_ms; $n.rtt_p50_ms // $n.rtt_avg_ms),
+			   $n.cpu_us_per_packet, pct($o.cpu_us_per_packet; $n.cpu_us_per_packet)])
+		| @tsv' | awk -F'\t' '{ printf "%-9s %-12s %5s %9s %6s %8s %6s %11s %6s\n",
+			$1, $2, $3, $4, $5, $6, $7, $8, $9 }'
+}
+
+mode_flags()
+{
+	case "$1" in
+		interval)		echo "-i 0.2" ;;
+		quiet)			echo "-q -i 0.2" ;;
+		flood)			echo "-f" ;;
+		flood-quiet)	echo "-f -q" ;;
+		preload)		echo "-f -q -l 32" ;;
+		window)			echo "-f -q --window 32" ;;
+		*)				echo "unknown mode $1" >&2; exit 1 ;;
+	esac
+}
+
+setup_veth()
+{
+	ip netns add "$NS" 2>/dev/null || return 1
+	ip link add ftpb0 type veth peer name ftpb1 netns "$NS" || return 1
+	ip addr add "$VETH_LOCAL/30" dev ftpb0
+	ip link set ftpb0 up
+	ip -n "$NS" addr add "$VETH_PEER/30" dev ftpb1
+	ip -n "$NS" link set ftpb1 up
+	ip -n "$NS" link set lo up
+	ip netns exec "$NS" sysctl -qw net.ipv4.icmp_ratelimit=0
+}
+
+# The responder answers from its own namespace, published as $NS_TUN
+setup_tun()
+{
+	local i
+
+	[ -x "$RESPONDER" ] || return 1
+	"$RESPONDER" -n "$NS_TUN" ${RESPONDER_SPEC:+-d "$RESPONDER_SPEC"} 2> /dev/null &
+	RESPONDER_PID=$!
+	for i in $(seq 20); do
+		[ -e "/run/netns/$NS_TUN" ] && return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+cleanup()
+{
+	ip netns del "$NS" 2>/dev/null
+	if [ -n "$RESPONDER_PID" ]; then
+		kill -INT "$RESPONDER_PID" 2>/dev/null
+		wait "$RESPONDER_PID" 2>/dev/null
+	fi
+	rm -f "$OUT" "$TIMES"
+}
+
+# Percentile p (0-100) of the sorted values in $TIMES, "null" when empty
+percentile()
+{
+	awk -v p="$1" '{ v[NR] = $1 } END {
+		if (NR == 0) { print "null"; exit }
+		i = int((NR - 1) * p / 100) + 1
+		printf "%.3f\n", v[i] }' "$TIMES"
+}
+
+run_one()
+{
+	local target=$1 addr=$2 mode=$3 size=$4
+	local flags cpu start wall sent rcvd stats jitter runs ge netns=
+
+	flags=$(mode_flags "$mode")
+	[ "$target" = tun ] && netns="ip netns exec $NS_TUN"
+	start=$(date +%s%N)
+	cpu=$( { TIMEFORMAT='%U %S'; time $netns $BIN $flags --jitter -s "$size" -w "$DURATION" \
+		"$addr" > "$OUT" 2> /dev/null; } 2>&1 )
+	wall=$(( $(date +%s%N) - start ))
+	sent=$(sed -n 's/^\([0-9]*\) packets transmitted.*/\1/p' "$OUT")
+	rcvd=$(sed -n 's/.* \([0-9]*\) packets received.*/\1/p' "$OUT")
+	stats=$(sed -n 's|^round-trip min/avg/max/stddev = \(.*\) ms|\1|p' "$OUT" | tr '/' ' ')
+	jitter=$(sed -n 's/^jitter = \([0-9.]*\) ms.*/\1/p' "$OUT")
+	runs=$(sed -n 's|^loss runs [^=]*= \(.*\)|[\1]|p' "$OUT" | tr '/' ',')
+	ge=$(sed -n 's/^gilbert-elliott p = \([0-9.]*\) r = \([0-9.]*\).*/\1 \2/p' "$OUT")
+	sed -n 's/.* time=\([0-9.]*\) ms.*/\1/p' "$OUT" | sort -n > "$TIMES"
+	sent=${sent:-0}
+	rcvd=${rcvd:-0}
+	set -- $stats
+	jq -n -c --arg target "$target" --arg mode "$mode" --argjson size "$size" \
+		--arg build "$BUILD" --argjson wall_ns "$wall" --arg cpu "$cpu" \
+		--argjson sent "$sent" --argjson rcvd "$rcvd" \
+		--arg min "${1:-}" --arg avg "${2:-}" --arg max "${3:-}" --arg sd "${4:-}" \
+		--argjson p50 "$(percentile 50)" --argjson p90 "$(percentile 90)" \
+		--argjson p99 "$(percentile 99)" --argjson samples "$(wc -l < "$TIMES")" \
+		--arg jitter "$jitter" --argjson runs "${runs:-null}" --arg ge "$ge" '
+		def n: if . == "" then null else tonumber end;
+		($cpu | split(" ") | map(tonumber) | add) as $cpu_s
+		| ($wall_ns / 1e9) as $wall
+		| {build: $build, target: $target, mode: $mode, size: $size,
+		   seconds: ($wall * 1000 | round / 1000),
+		   sent: $sent, received: $rcvd,
+		   loss_pct: (if $sent > 0 then (($sent - $rcvd) * 10000 / $sent | round) / 100 else null end),
+		   pps: (if $wall > 0 then ($sent / $wall | round) else null end),
+		   cpu_seconds: $cpu_s,
+		   cpu_us_per_packet: (if $sent > 0 then ($cpu_s * 1e7 / $sent | round) / 10 else null end),
+		   rtt_min_ms: ($min | n), rtt_avg_ms: ($avg | n),
+		   rtt_max_ms: ($max | n), rtt_stddev_ms: ($sd | n),
+		   rtt_samples: $samples,
+		   rtt_p50_ms: $p50, rtt_p90_ms: $p90, rtt_p99_ms: $p99,
+		   jitter_ms: ($jitter | n), loss_runs: $runs,
+		   gilbert_p: ($ge | split(" ")[0] // "" | n),
+		   gilbert_r: ($ge | split(" ")[1] // "" | n)}'
+}
+
+while getopts "d:o:s:m:b:r:c:h" opt; do
+	case "$opt" in
+		d) DURATION=$OPTARG ;;
+		o) REPORT=$OPTARG ;;
+		s) SIZES=$OPTARG ;;
+		m) MODES=$OPTARG ;;
+		b) BIN=$OPTARG ;;
+		r) RESPONDER_SPEC=$OPTARG ;;
+		c) compare "$OPTARG" "${!OPTIND}"; exit $? ;;
+		*) usage; exit 1 ;;
+	esac
+done
+
+if [ "$(id -u)" -ne 0 ]; then
+	echo "$0: raw sockets and network namespaces need root" >&2
+	exit 1
+fi
+if [ ! -x "$BIN" ]; then
+	echo "$0: $BIN not found, run make first" >&2
+	exit 1
+fi
+command -v jq > /dev/null || { echo "$0: jq is required" >&2; exit 1; }
+
+OUT=$(mktemp)
+TIMES=$(mktemp)
+trap cleanup EXIT
+BUILD=$(git describe --always --dirty 2> /dev/null || echo unknown)
+TARGETS="loopback=127.0.0.1"
+if setup_veth; then
+	TARGETS="$TARGETS veth=$VETH_PEER"
+else
+	echo "$0: no network namespace support, loopback only" >&2
+fi
+if setup_tun; then
+	TARGETS="$TARGETS tun=$TUN_PEER"
+else
+	echo "$0: no $RESPONDER (make responder) or no TUN support, skipping tun" >&2
+fi
+
+: > "$REPORT"
+printf "%-9s %-12s %5s %9s %7s %11s %9s %9s\n" \
+	TARGET MODE SIZE PPS LOSS% CPU_US/PKT AVG_MS P99_MS
+for t in $TARGETS; do
+	for mode in $MODES; do
+		for size in $SIZES; do
+			line=$(run_one "${t%%=*}" "${t#*=}" "$mode" "$size")
+			echo "$line" >> "$REPORT"
+			echo "$line" | jq -r '[.target, .mode, .size, .pps, .loss_pct,
+				.cpu_us_per_packet, (.rtt_avg_ms // "-"), (.rtt_p99_ms // "-")]
+				| @tsv' | awk -F'\t' '{ printf "%-9s %-12s %5s %9s %7s %11s %9s %9s\n",
+				$1, $2, $3, $4, $5, $6, $7, $8 }'
+		done
+	done
+done
+echo "report: $REPORT ($BUILD)"
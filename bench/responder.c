@@ -0,0 +1,647 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   responder.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 11:03:31 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 11:03:31 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#define _GNU_SOURCE	// unshare, CLONE_NEWNET
+#include "ft_ping.h"
+#include <limits.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+#include <poll.h>
+
+/**
+ * Userspace echo responder: a reproducible target for the benchmarks.
+ * It moves into a network namespace of its own and creates a TUN device
+ * there, with RESPONDER_ADDR on our side. Every other address of the /16
+ * routes into the device. The responder answers echo requests itself, so
+ * icmp_ratelimit and the kernel's loopback shortcuts never apply. Replies can
+ * be delayed (constant + a uniform, normal, exponential or pareto part),
+ * lost, duplicated and reordered, as with ft_ping --simulate.
+ *
+ *     sudo ./ft_ping_responder -d delay=1,jitter=0.2,dist=normal \
+ *         -- ./ft_ping -f --window 64 -w 10 10.255.0.2
+ *     sudo ./ft_ping_responder -n ftping-tun &	# then ip netns exec
+ *
+ * Each of the -t threads owns a queue of the multiqueue device. Replies due
+ * now are written straight back from the read buffer; delayed ones wait in
+ * a per-thread min-heap.
+ */
+# define RESPONDER_DEV "ftping0"
+# define RESPONDER_ADDR "10.255.0.1"
+# define RESPONDER_MASK "255.255.0.0"
+# define RESPONDER_MTU 65535
+# define RESPONDER_MAX_THREADS 64
+# define RESPONDER_BATCH 64		// reads before flushing due replies
+# define RESPONDER_IDLE_MS 100	// poll timeout, to notice a stop
+# define PARETO_SHAPE 1.5
+
+typedef enum e_dist
+{
+	DIST_UNIFORM,
+	DIST_NORMAL,
+	DIST_EXP,
+	DIST_PARETO
+}	t_dist;
+
+typedef struct s_spec
+{
+	double		delay_us;
+	double		jitter_us;	// range, deviation or mean of the random part
+	t_dist		dist;
+	double		loss;		// percentages
+	double		dup;
+	double		reorder;
+	uint64_t	seed;
+}	t_spec;
+
+typedef struct s_reply
+{
+	uint64_t	due;		// CLOCK_MONOTONIC ns
+	uint64_t	order;		// FIFO among replies due at the same time
+	uint16_t	len;
+	uint8_t		*data;
+}	t_reply;
+
+typedef struct s_queue
+{
+	pthread_t	thread;
+	int			fd;
+	uint64_t	rng;
+	t_reply		*heap;
+	size_t		len;
+	size_t		cap;
+	uint64_t	order;
+	uint64_t	requests;
+	uint64_t	replies;
+	uint64_t	dropped;
+	uint64_t	duplicated;
+	uint64_t	reordered;
+	uint64_t	ignored;
+	uint8_t		buf[RESPONDER_MTU + 1];
+}	t_queue;
+
+static t_spec					g_spec;
+static volatile sig_atomic_t	g_stop;
+
+static void	on_signal(int signum)
+{
+	(void)signum;
+	g_stop = 1;
+}
+
+static uint64_t	now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* xorshift64*, as simnet.c */
+static double	queue_random(t_queue *queue)
+{
+	queue->rng ^= queue->rng >> 12;
+	queue->rng ^= queue->rng << 25;
+	queue->rng ^= queue->rng >> 27;
+	return (((queue->rng * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53);
+}
+
+/* The random part of the delay, in microseconds */
+static double	queue_jitter(t_queue *queue)
+{
+	double	u;
+	double	v;
+
+	if (g_spec.jitter_us <= 0)
+		return (0);
+	u = queue_random(queue);
+	if (g_spec.dist == DIST_UNIFORM)
+		return (u * g_spec.jitter_us);
+	if (g_spec.dist == DIST_EXP)
+		return (-log(1 - u) * g_spec.jitter_us);
+	if (g_spec.dist == DIST_PARETO)
+		return (g_spec.jitter_us * (PARETO_SHAPE - 1)
+			* (pow(1 - u, -1 / PARETO_SHAPE) - 1));
+	// Box-Muller, cut at zero: a reply never leaves before its request
+	v = queue_random(queue);
+	u = sqrt(-2 * log(1 - u)) * cos(2 * M_PI * v) * g_spec.jitter_us;
+	return (u > -g_spec.delay_us ? u : -g_spec.delay_us);
+}
+
+static bool	reply_before(const t_reply *a, const t_reply *b)
+{
+	if (a->due != b->due)
+		return (a->due < b->due);
+	return (a->order < b->order);
+}
+
+static void	reply_swap(t_reply *a, t_reply *b)
+{
+	t_reply	tmp;
+
+	tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+static void	queue_push(t_queue *queue, const uint8_t *data, size_t len,
+		uint64_t due)
+{
+	t_reply	*heap;
+	size_t	i;
+
+	if (queue->len == queue->cap)
+	{
+		queue->cap = queue->cap ? queue->cap * 2 : 1024;
+		heap = realloc(queue->heap, queue->cap * sizeof(*heap));
+		if (!heap)
+		{
+			perror("ft_ping_responder: malloc");
+			exit(1);
+		}
+		queue->heap = heap;
+	}
+	i = queue->len++;
+	queue->heap[i].due = due;
+	queue->heap[i].order = queue->order++;
+	queue->heap[i].len = len;
+	queue->heap[i].data = malloc(len);
+	if (!queue->heap[i].data)
+	{
+		perror("ft_ping_responder: malloc");
+		exit(1);
+	}
+	memcpy(queue->heap[i].data, data, len);
+	while (i && reply_before(&queue->heap[i], &queue->heap[(i - 1) / 2]))
+	{
+		reply_swap(&queue->heap[i], &queue->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+}
+
+static void	queue_pop(t_queue *queue)
+{
+	size_t	i;
+	size_t	child;
+
+	free(queue->heap[0].data);
+	queue->heap[0] = queue->heap[--queue->len];
+	i = 0;
+	while ((child = 2 * i + 1) < queue->len)
+	{
+		if (child + 1 < queue->len
+			&& reply_before(&queue->heap[child + 1], &queue->heap[child]))
+			child++;
+		if (!reply_before(&queue->heap[child], &queue->heap[i]))
+			break ;
+		reply_swap(&queue->heap[i], &queue->heap[child]);
+		i = child;
+	}
+}
+
+static void	queue_write(t_queue *queue, const uint8_t *data, size_t len)
+{
+	// A full device queue drops, like a real link would
+	if (write(queue->fd, data, len) == (ssize_t)len)
+		queue->replies++;
+}
+
+/* RFC 1624: the checksum after a 16-bit word went from old to new */
+static uint16_t	checksum_adjust(uint16_t check, uint16_t old, uint16_t new)
+{
+	uint32_t	sum;
+
+	sum = (uint16_t)~check + (uint16_t)~old + new;
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (~sum);
+}
+
+/* One copy, after delay + jitter (+ a hold back when picked to reorder) */
+static void	queue_schedule(t_queue *queue, const uint8_t *data, size_t len,
+		uint64_t now)
+{
+	double	delay;
+
+	delay = g_spec.delay_us + queue_jitter(queue);
+	if (g_spec.reorder > 0 && queue_random(queue) * 100 < g_spec.reorder)
+	{
+		delay += g_spec.delay_us + g_spec.jitter_us + 1000;
+		queue->reordered++;
+	}
+	if (delay < 1 && !queue->len)
+		queue_write(queue, data, len);
+	else
+		queue_push(queue, data, len, now + (uint64_t)(delay * 1000));
+}
+
+/* Turns an echo request into its reply in place, then schedules it.
+Fragments and anything but echo requests are left to time out. */
+static void	queue_answer(t_queue *queue, uint8_t *data, size_t len,
+		uint64_t now)
+{
+	t_ip_header		*ip;
+	t_icmp_header	*icmp;
+	size_t			hlen;
+	uint16_t		old;
+	in_addr_t		addr;
+
+	ip = (t_ip_header *)data;
+	hlen = ip->ihl * 4;
+	if (len < sizeof(*ip) || ip->version != 4 || hlen < sizeof(*ip)
+		|| len < hlen + ICMP_HEADER_SIZE || ip->protocol != IPPROTO_ICMP
+		|| (ntohs(ip->frag_off) & (IP_MF | IP_OFFMASK)))
+	{
+		queue->ignored++;
+		return ;
+	}
+	icmp = (t_icmp_header *)(data + hlen);
+	if (icmp->type != ICMP_ECHO || icmp->code != 0)
+	{
+		queue->ignored++;
+		return ;
+	}
+	queue->requests++;
+	if (g_spec.loss > 0 && queue_random(queue) * 100 < g_spec.loss)
+	{
+		queue->dropped++;
+		return ;
+	}
+	// Swapping the addresses leaves the IP checksum as it is
+	addr = ip->saddr;
+	ip->saddr = ip->daddr;
+	ip->daddr = addr;
+	old = *(uint16_t *)icmp;
+	icmp->type = ICMP_ECHOREPLY;
+	icmp->checksum = checksum_adjust(icmp->checksum, old, *(uint16_t *)icmp);
+	queue_schedule(queue, data, len, now);
+	if (g_spec.dup > 0 && queue_random(queue) * 100 < g_spec.dup)
+	{
+		queue->duplicated++;
+		queue_schedule(queue, data, len, now);
+	}
+}
+
+static void	queue_flush(t_queue *queue, uint64_t now)
+{
+	while (queue->len && queue->heap[0].due <= now)
+	{
+		queue_write(queue, queue->heap[0].data, queue->heap[0].len);
+		queue_pop(queue);
+	}
+}
+
+static void	*queue_run(void *arg)
+{
+	t_queue			*queue;
+	struct pollfd	pfd;
+	uint64_t		now;
+	int				timeout;
+	int				i;
+	ssize_t			bytes;
+
+	queue = arg;
+	pfd.fd = queue->fd;
+	pfd.events = POLLIN;
+	while (!g_stop)
+	{
+		timeout = RESPONDER_IDLE_MS;
+		if (queue->len)
+		{
+			now = now_ns();
+			timeout = queue->heap[0].due <= now ? 0
+				: (int)((queue->heap[0].due - now + 999999) / 1000000);
+			if (timeout > RESPONDER_IDLE_MS)
+				timeout = RESPONDER_IDLE_MS;
+		}
+		if (poll(&pfd, 1, timeout) < 0 && errno != EINTR)
+		{
+			perror("ft_ping_responder: poll");
+			break ;
+		}
+		now = now_ns();
+		for (i = 0; i < RESPONDER_BATCH; i++)
+		{
+			bytes = read(queue->fd, queue->buf, sizeof(queue->buf));
+			if (bytes <= 0)
+				break ;
+			queue_answer(queue, queue->buf, bytes, now);
+		}
+		queue_flush(queue, now_ns());
+	}
+	while (queue->len)
+		queue_pop(queue);
+	free(queue->heap);
+	return (NULL);
+}
+
+/* One more queue of the device, created by the first call */
+static int	tun_open(void)
+{
+	struct ifreq	ifr;
+	int				fd;
+
+	fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+	{
+		perror("ft_ping_responder: /dev/net/tun");
+		exit(1);
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI | IFF_MULTI_QUEUE;
+	strncpy(ifr.ifr_name, RESPONDER_DEV, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+	{
+		perror("ft_ping_responder: TUNSETIFF");
+		exit(1);
+	}
+	return (fd);
+}
+
+static void	if_ioctl(int sock, unsigned long request, struct ifreq *ifr,
+		const char *what)
+{
+	if (ioctl(sock, request, ifr) < 0)
+	{
+		fprintf(stderr, "ft_ping_responder: %s: %s\n", what, strerror(errno));
+		exit(1);
+	}
+}
+
+static void	if_set_addr(int sock, const char *name, unsigned long request,
+		const char *addr)
+{
+	struct ifreq		ifr;
+	struct sockaddr_in	*sin;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	sin = (struct sockaddr_in *)&ifr.ifr_addr;
+	sin->sin_family = AF_INET;
+	inet_pton(AF_INET, addr, &sin->sin_addr);
+	if_ioctl(sock, request, &ifr, name);
+}
+
+static void	if_up(int sock, const char *name)
+{
+	struct ifreq	ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if_ioctl(sock, SIOCGIFFLAGS, &ifr, name);
+	ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+	if_ioctl(sock, SIOCSIFFLAGS, &ifr, name);
+}
+
+/* Address, mask (the /16 route comes with it), MTU and link up, through
+plain ioctls: no dependency on iproute2 */
+static void	tun_configure(void)
+{
+	struct ifreq	ifr;
+	int				sock;
+
+	sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+	{
+		perror("ft_ping_responder: socket");
+		exit(1);
+	}
+	if_up(sock, "lo");
+	if_set_addr(sock, RESPONDER_DEV, SIOCSIFADDR, RESPONDER_ADDR);
+	if_set_addr(sock, RESPONDER_DEV, SIOCSIFNETMASK, RESPONDER_MASK);
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, RESPONDER_DEV, IFNAMSIZ - 1);
+	ifr.ifr_mtu = RESPONDER_MTU;
+	if_ioctl(sock, SIOCSIFMTU, &ifr, "mtu");
+	if_up(sock, RESPONDER_DEV);
+	close(sock);
+}
+
+/* Makes the namespace reachable as `ip netns exec NAME` */
+static void	netns_publish(const char *name, char *path, size_t size)
+{
+	int	fd;
+
+	snprintf(path, size, "/run/netns/%s", name);
+	mkdir("/run/netns", 0755);
+	fd = open(path, O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0444);
+	if (fd < 0)
+	{
+		fprintf(stderr, "ft_ping_responder: %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	close(fd);
+	if (mount("/proc/self/ns/net", path, "none", MS_BIND, NULL) < 0)
+	{
+		fprintf(stderr, "ft_ping_responder: mount %s: %s\n", path,
+			strerror(errno));
+		unlink(path);
+		exit(1);
+	}
+}
+
+static void	spec_parse(const char *spec)
+{
+	char	buf[256];
+	char	*item;
+	char	*value;
+	char	*save;
+	char	*endptr;
+	double	number;
+
+	if (strlen(spec) >= sizeof(buf))
+	{
+		fprintf(stderr, "ft_ping_responder: -d settings too long\n");
+		exit(1);
+	}
+	strcpy(buf, spec);
+	for (item = strtok_r(buf, ",", &save); item;
+		item = strtok_r(NULL, ",", &save))
+	{
+		value = strchr(item, '=');
+		if (value)
+			*value++ = '\0';
+		if (value && !strcmp(item, "dist"))
+		{
+			if (!strcmp(value, "uniform"))
+				g_spec.dist = DIST_UNIFORM;
+			else if (!strcmp(value, "normal"))
+				g_spec.dist = DIST_NORMAL;
+			else if (!strcmp(value, "exp"))
+				g_spec.dist = DIST_EXP;
+			else if (!strcmp(value, "pareto"))
+				g_spec.dist = DIST_PARETO;
+			else
+				break ;
+			continue ;
+		}
+		number = value ? strtod(value, &endptr) : -1;
+		if (!value || endptr == value || *endptr || number < 0)
+			break ;
+		if (!strcmp(item, "delay"))
+			g_spec.delay_us = number * 1000;
+		else if (!strcmp(item, "jitter"))
+			g_spec.jitter_us = number * 1000;
+		else if (!strcmp(item, "loss") && number <= 100)
+			g_spec.loss = number;
+		else if (!strcmp(item, "dup") && number <= 100)
+			g_spec.dup = number;
+		else if (!strcmp(item, "reorder") && number <= 100)
+			g_spec.reorder = number;
+		else if (!strcmp(item, "seed"))
+			g_spec.seed = (uint64_t)number;
+		else
+			break ;
+	}
+	if (item)
+	{
+		fprintf(stderr, "ft_ping_responder: invalid -d setting '%s'\n", item);
+		exit(1);
+	}
+}
+
+static void	usage(const char *prog)
+{
+	fprintf(stderr, "Usage: sudo %s [-d SPEC] [-t THREADS] [-n NETNS] "
+		"[-- COMMAND ...]\n", prog);
+	fprintf(stderr, "  SPEC: delay=MS,jitter=MS,dist=uniform|normal|exp|pareto,"
+		"loss=%%,dup=%%,reorder=%%,seed=N\n");
+	fprintf(stderr, "  Answers echo requests to %s/16 but %s, inside a "
+		"namespace of its own.\n", RESPONDER_ADDR, RESPONDER_ADDR);
+	fprintf(stderr, "  COMMAND runs there too and the responder exits with it;"
+		" else -n NETNS\n  names the namespace for ip netns exec and the "
+		"responder runs until SIGINT.\n");
+	exit(1);
+}
+
+/* Starts COMMAND in the namespace and waits for it, status as exit code */
+static int	run_command(char **argv)
+{
+	pid_t	pid;
+	int		status;
+
+	pid = fork();
+	if (pid < 0)
+	{
+		perror("ft_ping_responder: fork");
+		return (1);
+	}
+	if (pid == 0)
+	{
+		execvp(argv[0], argv);
+		fprintf(stderr, "ft_ping_responder: %s: %s\n", argv[0],
+			strerror(errno));
+		_exit(127);
+	}
+	while (waitpid(pid, &status, 0) < 0)
+	{
+		if (errno != EINTR)
+			return (1);
+	}
+	if (WIFSIGNALED(status))
+		return (128 + WTERMSIG(status));
+	return (WEXITSTATUS(status));
+}
+
+static void	print_stats(t_queue *queues, int nthreads)
+{
+	t_queue	total;
+	int		i;
+
+	memset(&total, 0, offsetof(t_queue, buf));
+	for (i = 0; i < nthreads; i++)
+	{
+		total.requests += queues[i].requests;
+		total.replies += queues[i].replies;
+		total.dropped += queues[i].dropped;
+		total.duplicated += queues[i].duplicated;
+		total.reordered += queues[i].reordered;
+		total.ignored += queues[i].ignored;
+	}
+	fprintf(stderr, "responder: %lu requests, %lu replies, %lu dropped, "
+		"%lu duplicated, %lu reordered, %lu ignored\n",
+		(unsigned long)total.requests, (unsigned long)total.replies,
+		(unsigned long)total.dropped, (unsigned long)total.duplicated,
+		(unsigned long)total.reordered, (unsigned long)total.ignored);
+}
+
+int	main(int ac, char **av)
+{
+	static t_queue	queues[RESPONDER_MAX_THREADS];
+	const char		*netns;
+	char			path[PATH_MAX];
+	int				nthreads;
+	int				status;
+	int				opt;
+	int				i;
+
+	netns = NULL;
+	nthreads = 1;
+	g_spec.seed = now_ns() ^ getpid();
+	while ((opt = getopt(ac, av, "+d:t:n:h")) != -1)
+	{
+		if (opt == 'd')
+			spec_parse(optarg);
+		else if (opt == 't')
+		{
+			nthreads = atoi(optarg);
+			if (nthreads < 1 || nthreads > RESPONDER_MAX_THREADS)
+				usage(av[0]);
+		}
+		else if (opt == 'n')
+			netns = optarg;
+		else
+			usage(av[0]);
+	}
+	if (!netns && optind >= ac)
+		usage(av[0]);
+	if (unshare(CLONE_NEWNET) < 0)
+	{
+		perror("ft_ping_responder: unshare");
+		return (1);
+	}
+	for (i = 0; i < nthreads; i++)
+	{
+		queues[i].fd = tun_open();
+		// xorshift never leaves 0, and every queue draws its own numbers
+		queues[i].rng = (g_spec.seed + i) * 0x9E3779B97F4A7C15ULL | 1;
+	}
+	tun_configure();
+	if (netns)
+		netns_publish(netns, path, sizeof(path));
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&queues[i].thread, NULL, queue_run, &queues[i]);
+	status = 0;
+	if (optind < ac)
+		status = run_command(av + optind);
+	else
+		while (!g_stop)
+			pause();
+	g_stop = 1;
+	for (i = 0; i < nthreads; i++)
+	{
+		pthread_join(queues[i].thread, NULL);
+		close(queues[i].fd);
+	}
+	if (netns)
+	{
+		umount2(path, MNT_DETACH);
+		unlink(path);
+	}
+	print_stats(queues, nthreads);
+	return (status);
+}
@@ -31,12 +31,34 @@
 # include <sys/select.h>
 # include <ctype.h>
 # include <getopt.h>
+# include <pthread.h>
+# include <fcntl.h>
+# include <time.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sched.h>
+# if defined(__has_include) && !defined(FT_PING_NO_USDT)
+#  if __has_include(<sys/sdt.h>)
+#   include <sys/sdt.h>
+#   define FT_PING_USDT
+#  endif
+# endif
+# if defined(FT_PING_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h>
+# endif
+# ifdef __SSE2__
+#  include <emmintrin.h>
+# endif
 
 # define ICMP_HEADER_SIZE 8
 # define PAYLOAD_SIZE (PACKET_SIZE - ICMP_HEADER_SIZE)
 # define PACKET_SIZE 64
 # define MAX_IP_HEADER_SIZE 60
-# define RECV_BUFFER_SIZE (2 * MAX_IP_HEADER_SIZE + ICMP_HEADER_SIZE + PACKET_SIZE)
+# define MIN_PAYLOAD_SIZE 0		// RTTs come from the send-time table
+# define MAX_PAYLOAD_SIZE (IP_MAXPACKET - 20 - ICMP_HEADER_SIZE)
+# define MAX_PACKET_SIZE (ICMP_HEADER_SIZE + MAX_PAYLOAD_SIZE)
+# define RECV_BUFFER_SIZE IP_MAXPACKET	// a whole IP datagram, whatever -s is
+# define PATTERN_MAX 16			// -p bytes, like inetutils
 /**
  * RFC 792: ICMP error structure
  * ┌───────────────────────────────┐
@@ -52,7 +74,57 @@
  * └───────────────────────────────┘
  */
 # define INTERVAL_MS 1000
-# define DUP_TABLE_SIZE 8192
+# define DUP_WINDOW_MIN 256		// sequences per dup window, a power of two
+# define ARENA_ALIGN 64			// cache line
+# define DNS_TTL_DEFAULT 300
+# define RESOLVER_THREADS 16
+# define MAX_RESOLVER_THREADS 64
+# define ADDR_CACHE_BITS 10
+# define ADDR_CACHE_SIZE (1 << ADDR_CACHE_BITS)
+# define ADDR_CACHE_PROBES 8
+# define ADDR_TEXT_SIZE 128
+# define PTR_QUEUE_SIZE 256
+# define TRACE_MAX_HOPS 64
+# define TRACE_DEFAULT_HOPS 30
+# define TRACE_SLOTS 4096
+# define TRACE_ADDRS 3
+# define PMTU_MIN 68		// RFC 791: every IPv4 link carries 68 bytes
+# define PMTU_PROBES 16
+# define PMTU_SLOTS 256
+# define PMTU_MAX_IDLE 3
+# define SWEEP_MIN_PREFIX 8	// /8 = 16M addresses, a 2 MiB reply bitmap
+# define SWEEP_PROBES 65536	// send times kept, one per icmp_seq
+# define SWEEP_RATE_DEFAULT 1000
+# define SWEEP_LINGER_MS 1000	// wait for late replies after the last probe
+# define PCAP_BUFFER_SIZE (1 << 20)
+# define PCAP_FLUSH_MS 1000
+# define SKETCH_ALPHA 0.02		// relative error of the RTT percentiles
+# define SKETCH_BINS 512		// 1 us to 100+ s at 2%: 2 KiB per target
+# define SKETCH_VERSION 2
+# define SKETCH_LINE_SIZE 16384
+# define LOSS_WINDOW 128		// probes a reply may trail and still count
+# define FLOOD_WINDOW_MAX 32768	// half the largest dup window
+# define FLOOD_MIN_RTO 10000		// usec: a flood sends at least 100/s
+# define FLOOD_INITIAL_RTO 1000000	// usec, before any RTT is known
+# define DEADLINE_RING_MIN 1024
+# define VIRTUAL_EPOCH 1000000000	// --virtual-clock start, 2001-09-09
+# define LOSS_RUN_BUCKETS 8
+# define SERIES_TIERS 3
+# define SERIES_SECONDS 300		// 5 minutes of 1 s slots
+# define SERIES_MINUTES 720		// 12 hours of 1 min slots
+# define SERIES_HOURS 720		// 30 days of 1 h slots: ~940 KiB in all
+# define SERIES_BINS 128
+# define SERIES_GAMMA 1.16		// 1 us to 150 s, quantiles within 8%
+# define LOWLAT_BUSY_POLL 50	// usec of SO_BUSY_POLL
+# define LOWLAT_STACK (256 * 1024)	// stack prefaulted by --low-latency
+# define PCAP_MAGIC_USEC 0xa1b2c3d4
+# define PCAP_MAGIC_NSEC 0xa1b23c4d	// nanosecond timestamps
+# define LINKTYPE_NULL 0
+# define LINKTYPE_ETHERNET 1
+# define LINKTYPE_RAW 101		// packets start at the IP header
+# define LINKTYPE_LINUX_SLL 113
+# define LINKTYPE_IPV4 228
+# define LINKTYPE_LINUX_SLL2 276
 
 typedef struct icmphdr	t_icmp_header;
 typedef struct iphdr	t_ip_header;
@@ -72,6 +144,23 @@ typedef enum e_wait_result
 	WAIT_READY = 1
 }	t_wait_result;
 
+/**
+ * Hot path stages for the profiler built with `make PROFILE=1`
+ * (FT_PING_PROFILE). PROF_START / PROF_STOP bracket a stage with two
+ * cycle counter reads; without the flag they compile to nothing.
+ */
+typedef enum e_prof_stage
+{
+	PROF_SEND,			// send_echo
+	PROF_WAIT,			// select, or the --low-latency spin
+	PROF_RECV,			// receive_packet
+	PROF_PROCESS,		// process_packet, print_echo included
+	PROF_PRINT,			// print_echo
+	PROF_STAGES
+}	t_prof_stage;
+
+# define PROF_BUCKETS 64	// log2 of the cycle count
+
 enum	e_options
 {
 	COUNT,
@@ -82,35 +171,541 @@ enum	e_options
 	FLOOD,
 	PRELOAD,
 	QUIET,
+	DNS_TTL,
+	RESOLVERS,
+	RDNS,
+	TRACE,
+	MAX_HOPS,
+	SIZE,
+	PMTU,
+	RATE,
+	SIMULATE,
+	PCAP,
+	REPLAY,
+	PERCENTILES,
+	SAVE_SKETCH,
+	MERGE_SKETCH,
+	JITTER,
+	SERIES,
+	CHECK_STAMP,
+	LOW_LATENCY,
+	OVERHEAD,
+	PATTERN,
+	WINDOW,
+	LINGER,
+	VIRTUAL_CLOCK,
+	HDRINCL,
+	DSCP,
+	DONT_FRAGMENT,
+	IPID,
 	USAGE,
 	FLAGS_COUNT,
 	ONLY_LONG = 255
 };
 
+typedef enum e_target_state
+{
+	TARGET_RESOLVING,
+	TARGET_READY,
+	TARGET_FAILED
+}	t_target_state;
+
+// Mergeable RTT quantile sketch (DDSketch), fixed size
+typedef struct s_sketch
+{
+	uint64_t	count;
+	uint64_t	zero;					// RTTs below 1 us
+	long long	min;					// exact, quantiles stay within
+	long long	max;
+	uint32_t	bins[SKETCH_BINS];
+}	t_sketch;
+
+/**
+ * RFC 3550 jitter and loss bursts, updated per reply and per probe sent.
+ * Probes settle in sequence order app->settle_lag behind the sender;
+ * transitions[a][b] counts an outcome b (1 = lost) following outcome a.
+ */
+typedef struct s_loss_stats
+{
+	double		jitter;					// usec, smoothed |D|
+	long long	last_rtt;
+	int			replies;
+	uint16_t	first_seq;				// sequence of the first probe
+	int			settled;				// probes whose outcome is final
+	int			run;					// current run of lost probes
+	int			last;					// previous outcome, 1 = lost
+	uint32_t	runs[LOSS_RUN_BUCKETS];	// loss runs by length
+	uint32_t	transitions[2][2];
+}	t_loss_stats;
+
+// One time slot of --series: probes, replies and a coarse RTT histogram
+typedef struct s_series_slot
+{
+	time_t		start;
+	uint32_t	sent;
+	uint32_t	received;
+	long long	min;
+	long long	max;
+	long long	sum;
+	uint32_t	bins[SERIES_BINS];
+}	t_series_slot;
+
+typedef struct s_series_tier
+{
+	int				seconds;	// slot length
+	int				size;
+	int				head;		// open slot, the newest
+	int				count;
+	t_series_slot	*slots;		// ring inside t_series.slots
+}	t_series_tier;
+
+typedef struct s_series
+{
+	t_series_tier	tiers[SERIES_TIERS];
+	t_series_slot	slots[SERIES_SECONDS + SERIES_MINUTES + SERIES_HOURS];
+}	t_series;
+
+// --low-latency settings
+typedef struct s_lowlat
+{
+	int	cpu;
+	int	fifo;				// SCHED_FIFO priority, 0 keeps the policy
+	int	busy_poll;			// SO_BUSY_POLL usec, 0 = off
+}	t_lowlat;
+
+// One side of --overhead: time the probe loop itself adds, in usec
+typedef struct s_overhead_stat
+{
+	uint64_t	count;
+	long long	sum;
+	long long	max;
+}	t_overhead_stat;
+
+typedef struct s_sketch_entry
+{
+	char		name[ADDR_TEXT_SIZE];
+	t_sketch	sketch;
+}	t_sketch_entry;
+
+// Cold per destination data: names, only read at start and in reports
+typedef struct s_target_info
+{
+	const char			*hostname;
+	char				ip_str[INET_ADDRSTRLEN];
+	int					dns_next;			// next target sharing the same hostname
+}	t_target_info;
+
+/**
+ * Per destination state: one for every HOST given on the command line.
+ * Only what the probe and reply paths touch lives here, counters first;
+ * names, the dup window, the loss stats and the sketch are separate arrays
+ * of the same arena (see targets_alloc for the per target budget).
+ */
+typedef struct s_target
+{
+	uint16_t			id;					// echo id (pid + index)
+	uint16_t			sequence;			// last sequence number sent
+	uint16_t			oldest;				// -f: first probe maybe in flight
+	uint16_t			in_flight;			// -f: probes holding a window slot
+	t_target_state		state;
+	int					sent_packets;
+	int					rcv_packets;
+	int					dup_packets;
+	int					late_packets;		// -W: replies past their deadline
+	long long			stats[4];
+	double				variance_m2;		// For the Welford algorithm
+	uint8_t				*rcv_map;			// dup window, app->dup_window bits
+	uint32_t			*send_times;		// usec, low 32 bits, same window
+	int					bad_stamps;			// --check-stamp mismatches
+	int					corrupted;			// replies not echoing our data
+	struct sockaddr_in	dest_addr;			// destination address
+	t_loss_stats		*loss;				// --jitter only, else NULL
+	t_sketch			*sketch;			// RTT percentiles, NULL unless asked
+	t_target_info		*info;
+}	t_target;
+
+// -W: one probe waiting for its reply
+typedef struct s_deadline
+{
+	uint32_t	target;					// index in app->targets
+	uint16_t	seq;
+}	t_deadline;
+
+// Probes in send order, the next deadline at the head
+typedef struct s_deadlines
+{
+	t_deadline	*ring;					// cap entries, a power of two
+	size_t		cap;
+	size_t		head;
+	size_t		len;
+}	t_deadlines;
+
+// Bump allocator: everything per target comes from one block, freed at once
+typedef struct s_arena
+{
+	uint8_t	*block;
+	uint8_t	*base;						// block aligned to ARENA_ALIGN
+	size_t	size;
+	size_t	used;
+}	t_arena;
+
+/**
+ * DNS cache entry, one per distinct hostname.
+ * name and the alias chain are written once before the workers start, the
+ * rest is only touched by the main thread (workers report through t_dns_done)
+ */
+typedef struct s_dns_entry
+{
+	const char		*name;
+	struct in_addr	addr;
+	time_t			expires;		// monotonic seconds, 0 = never resolved
+	int				status;			// last getaddrinfo status
+	bool			pending;		// a lookup is queued or running
+	int				first_target;	// head of the targets alias chain
+}	t_dns_entry;
+
+typedef struct s_dns_done
+{
+	size_t			entry;
+	int				status;
+	struct in_addr	addr;
+}	t_dns_done;
+
+/**
+ * Resolver thread pool: workers pop entry indices from `queue`, call
+ * getaddrinfo and push the outcome to `done`, then poke `pipefd` so the
+ * select() in the probe loop wakes up. Both rings hold at most one slot
+ * per entry, since an entry is never queued twice.
+ */
+typedef struct s_resolver
+{
+	pthread_t		threads[MAX_RESOLVER_THREADS];
+	int				nthreads;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	bool			shutdown;
+	int				pipefd[2];
+	size_t			*queue;
+	size_t			q_head;
+	size_t			q_len;
+	t_dns_done		*done;
+	size_t			d_head;
+	size_t			d_len;
+	t_dns_entry		*entries;
+	size_t			nentries;
+	size_t			*index;			// open addressing hostname -> entry
+	size_t			index_mask;
+	time_t			next_refresh;
+	size_t			pending;		// entries queued or being looked up
+}	t_resolver;
+
+typedef enum e_ptr_state
+{
+	PTR_NONE,
+	PTR_PENDING,
+	PTR_DONE
+}	t_ptr_state;
+
+// Reply source, formatted once and reused for every later reply
+typedef struct s_addr_entry
+{
+	in_addr_t	addr;
+	bool		used;
+	uint8_t		ptr;					// t_ptr_state
+	char		text[ADDR_TEXT_SIZE];	// "a.b.c.d" or "name (a.b.c.d)"
+}	t_addr_entry;
+
+typedef struct s_ptr_result
+{
+	in_addr_t	addr;
+	char		name[ADDR_TEXT_SIZE];
+}	t_ptr_result;
+
+/**
+ * Open addressing cache IPv4 address -> printable source.
+ * With --rdns one worker thread resolves PTR names: it pops from `queue`
+ * and pushes to `done`, the probe loop applies results in addr_cache_poll.
+ */
+typedef struct s_addr_cache
+{
+	t_addr_entry	entries[ADDR_CACHE_SIZE];
+	bool			rdns;
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	bool			shutdown;
+	in_addr_t		queue[PTR_QUEUE_SIZE];
+	size_t			q_head;
+	size_t			q_len;
+	t_ptr_result	done[PTR_QUEUE_SIZE];
+	size_t			d_head;
+	size_t			d_len;
+	size_t			outstanding;			// queued + resolving + done
+}	t_addr_cache;
+
+// Trace probe in flight, found back through its sequence number
+typedef struct s_trace_probe
+{
+	uint16_t		seq;
+	uint8_t			ttl;	// 0 when free or answered
+	struct timeval	sent;
+}	t_trace_probe;
+
+typedef struct s_trace_hop
+{
+	in_addr_t	addrs[TRACE_ADDRS];	// routers answering for this TTL
+	int			naddrs;
+	int			sent;
+	int			received;
+	long long	last;
+	long long	best;
+	long long	worst;
+	double		avg;
+	double		m2;					// For the Welford algorithm
+	char		flag;				// unreachable code (!H, !N...), 0 if none
+}	t_trace_hop;
+
+/**
+ * --trace: every round sends TTL 1..max_hops at once. Probes are kept in a
+ * ring indexed by sequence, so TRACE_SLOTS / max_hops rounds can be in
+ * flight before late answers are dropped.
+ */
+typedef struct s_trace
+{
+	int				max_hops;
+	int				dest_ttl;	// first TTL reaching the destination
+	int				rounds;
+	uint16_t		next_seq;
+	t_trace_probe	probes[TRACE_SLOTS];
+	t_trace_hop		hops[TRACE_MAX_HOPS];
+}	t_trace;
+
+typedef struct s_pmtu_probe
+{
+	uint16_t	seq;
+	uint16_t	size;		// whole IP datagram, in bytes
+	bool		pending;	// sent in the current round, not answered yet
+}	t_pmtu_probe;
+
+/**
+ * --pmtu: the path MTU lies in [lo, hi]. Every round probes several sizes
+ * of that range at once; hard_hi only moves on proof (Fragmentation Needed
+ * or EMSGSIZE) while hi also follows silent drops, which may be plain loss.
+ */
+typedef struct s_pmtu
+{
+	int				lo;
+	int				hi;
+	int				hard_hi;
+	bool			confirmed;		// lo was actually answered
+	bool			converged;
+	int				rounds;
+	int				idle_rounds;	// rounds in a row without any reply
+	int				probes_sent;
+	int				in_flight;
+	int				round_replies;
+	uint16_t		next_seq;
+	uint16_t		round_first;	// first sequence of the current round
+	t_pmtu_probe	probes[PMTU_SLOTS];
+	struct timeval	round_start;
+	struct timeval	start;
+}	t_pmtu;
+
+/**
+ * CIDR sweep: the range is walked in a pseudo-random order given by the
+ * cyclic group Z*_prime, one element per step, without building a list.
+ */
+// A probe of the sweep, for the RTT of its reply
+typedef struct s_sweep_probe
+{
+	uint32_t		index;			// address index, UINT32_MAX when unused
+	uint32_t		sent;			// microseconds since the start
+}	t_sweep_probe;
+
+typedef struct s_sweep
+{
+	uint32_t		base;			// first address, host order
+	uint32_t		size;			// addresses in the range
+	uint64_t		prime;			// smallest prime above size
+	uint64_t		generator;		// primitive root of prime
+	uint64_t		current;		// current group element
+	uint64_t		steps;			// group elements visited
+	uint32_t		next;			// address index waiting to be sent
+	bool			has_next;
+	uint32_t		probed;
+	uint32_t		responders;
+	uint8_t			*replied;		// one bit per address of the range
+	t_sweep_probe	*probes;		// SWEEP_PROBES, by icmp_seq
+	struct timeval	start;
+	struct timeval	finished;		// last probe sent, 0 before
+}	t_sweep;
+
+/**
+ * A received packet, parsed in one pass by packet_parse: lengths are checked
+ * there once, consumers read these fields and pointers (into the receive
+ * buffer) without validating again. For ICMP errors orig_* come from the
+ * echo request embedded in it, has_orig is false when there is none.
+ */
+typedef struct s_packet
+{
+	const t_ip_header	*ip;
+	const t_icmp_header	*icmp;
+	const uint8_t		*payload;		// after the ICMP header
+	int					len;			// ICMP message, header included
+	int					payload_len;
+	uint8_t				type;
+	uint8_t				code;
+	uint8_t				ttl;
+	bool				checksum_ok;
+	uint16_t			id;
+	uint16_t			seq;			// echo's own, or the embedded one
+	bool				has_orig;
+	uint16_t			orig_id;
+	in_addr_t			orig_daddr;
+}	t_packet;
+
+/**
+ * Packet I/O backend behind init_socket/send_packet/receive_packet.
+ * send returns the bytes sent (ttl 0 = socket default), recv the bytes read,
+ * both -1 with errno set; recv fails with EAGAIN when nothing is due.
+ * fd is watched by select(); backends without one (fd -1) report the time
+ * left before their next packet through next_event instead. Backends that
+ * build the IP header themselves point sent_ip at the last one sent.
+ */
+typedef struct s_transport
+{
+	const char	*name;
+	int			fd;
+	void		*ctx;
+	const t_ip_header	*sent_ip;	// NULL when the kernel adds the header
+	int			(*send)(struct s_transport *transport, const uint8_t *buf,
+				size_t len, const struct sockaddr_in *addr, int ttl);
+	int			(*recv)(struct s_transport *transport, uint8_t *buf,
+				size_t size, struct sockaddr_in *from, struct timeval *stamp);
+	bool		(*next_event)(struct s_transport *transport,
+				struct timeval *delay);
+	void		(*close)(struct s_transport *transport);
+}	t_transport;
+
+// Reply waiting in the simulated network
+typedef struct s_sim_packet
+{
+	struct timeval	due;
+	uint64_t		order;		// FIFO among packets due at the same time
+	in_addr_t		from;
+	uint16_t		len;
+	uint8_t			*data;		// IP header + ICMP
+}	t_sim_packet;
+
+typedef struct s_simnet
+{
+	double			delay_us;
+	double			jitter_us;
+	double			loss;		// percentages
+	double			dup;
+	double			reorder;
+	double			corrupt;	// a payload byte rewritten, checksum fixed
+	uint64_t		rng;
+	uint64_t		order;
+	t_sim_packet	*heap;		// min-heap on due time
+	size_t			len;
+	size_t			cap;
+	size_t			sent;
+	size_t			dropped;
+	size_t			duplicated;
+	size_t			reordered;
+	size_t			corrupted;
+}	t_simnet;
+
+// --hdrincl: the IPv4 header put in front of every probe
+typedef struct s_ip_template
+{
+	t_ip_header	ip;			// tot_len, id and daddr 0, check over the rest
+	t_ip_header	last;		// header of the last probe sent
+	uint16_t	next_id;
+	bool		dump;		// -v: print each datagram sent
+}	t_ip_template;
+
+/**
+ * Time source behind clock_now and the main loop wait. The real clock is
+ * gettimeofday and select. The virtual one (--virtual-clock) only moves when
+ * the loop waits, and then straight to the end of the wait: the next probe,
+ * simulated packet or deadline. Descriptors are polled without blocking, so
+ * a simulated day takes as long as the work it contains.
+ */
+typedef struct s_clock
+{
+	const char		*name;
+	struct timeval	now;		// virtual time, unused by the real clock
+	void			(*read)(struct s_clock *clock, struct timeval *tv);
+	int				(*wait)(struct s_clock *clock, int maxfd, fd_set *fdset,
+					struct timeval *timeout);
+}	t_clock;
+
+// --pcap writer, wrapping the transport it records
+typedef struct s_pcap
+{
+	t_transport		inner;
+	int				fd;
+	uint8_t			*buf;		// batch of records, PCAP_BUFFER_SIZE bytes
+	size_t			len;
+	struct timeval	first;		// timestamp of the oldest buffered record
+	size_t			packets;
+	int				ttl;		// for the rebuilt headers of requests
+	bool			failed;
+}	t_pcap;
+
+// --replay: capture file mapped in memory
+typedef struct s_replay
+{
+	const uint8_t	*map;
+	size_t			size;
+	size_t			offset;		// next record
+	bool			swapped;	// written on a host of the other byte order
+	bool			nsec;
+	uint32_t		linktype;
+	uint32_t		snaplen;	// no record is longer, whatever it claims
+}	t_replay;
+
 // Application state - tracks metadata, not the headers themselves
 typedef struct s_ft_ping
 {
 	volatile sig_atomic_t	stop; /* Written atomically (an int can be compiled in more assembly instructions that might be interrupted in the middle)*/
+	volatile sig_atomic_t	dump;			// SIGUSR1: write --series now
 	uint16_t				options[FLAGS_COUNT]; // allocates for the amount of flags I implemented
-	const char				*hostname;
-	char					ip_str[INET_ADDRSTRLEN];
-	int						socket;
-	struct addrinfo			*res;	// Linked list of addrinfo structs from getaddrinfo
+	char					**hostnames;	// HOST arguments from the command line
+	size_t					target_count;
+	t_target				*targets;
+	t_arena					arena;			// targets and their arrays
+	uint32_t				dup_window;		// sequences kept per target
+	uint32_t				settle_lag;		// probes before a loss is final
+	t_deadlines				deadlines;		// -W, empty otherwise
+	size_t					finished;		// targets failed or done with COUNT
+	t_resolver				*resolver;		// NULL for a single (blocking) HOST
+	t_addr_cache			*addr_cache;	// formatted reply sources
+	t_trace					*trace;			// --trace mode, NULL otherwise
+	t_pmtu					*pmtu;			// --pmtu mode, NULL otherwise
+	t_sweep					*sweep;			// CIDR HOST, NULL otherwise
+	t_series				*series;		// --series, NULL otherwise
+	t_transport				transport;		// raw socket or --simulate
+	t_clock					clock;			// real, or --virtual-clock
+	const char				*simulate;		// --simulate settings
+	const char				*pcap_path;		// --pcap FILE
+	const char				*replay_path;	// --replay FILE
+	const char				*sketch_path;	// --save-sketch FILE
+	const char				*series_path;	// --series FILE
+	const char				*low_latency;	// --low-latency settings
+	t_overhead_stat			overhead[2];	// --overhead: rx, tx
 	uint16_t				pid;           				// process ID for echo_id
-	uint16_t				sequence;      				// current sequence number
-	uint8_t					rcv_map[DUP_TABLE_SIZE];	// bitmap to track duplicates
 	size_t					packet_size;
-	int						sent_packets;
-	int						rcv_packets;
-	int						dup_packets;
 	struct timeval			start;
 	struct timeval			end;
-	uint8_t					sendbuffer[PACKET_SIZE];  		// ICMP header + payload
+	uint8_t					pattern[PATTERN_MAX];	// -p, empty for 0x42
+	size_t					pattern_len;
+	uint8_t					fill[MAX_PAYLOAD_SIZE];	// payload sent, but the stamp
+	uint8_t					sendbuffer[MAX_PACKET_SIZE];	// ICMP header + payload
 	uint8_t					recvbuffer[RECV_BUFFER_SIZE]; 	// received packet
-	struct sockaddr_in		dest_addr;              		// destination address
 	struct sockaddr_in		reply_addr;             		// address from last reply
-	double					variance_m2;					// For the Welford algorithm
-	long long				stats[4];
 }	t_ft_ping;
 
 /***** GLOBAL *****/
@@ -118,21 +713,48 @@ extern t_ft_ping	*g_ft_ping;
 
 /***** CLEANUP & SIGNALS *****/
 void	interrupt(int signum);
+void	request_dump(int signum);
 void	clean_up();
 
 /***** SETUP *****/
 void	setup_destination(t_ft_ping *app);
-int		resolv_hostname(t_ft_ping *app);
+int		resolv_hostname(const char *hostname, struct sockaddr_in *dest_addr);
+
+/***** TARGETS *****/
+void		targets_alloc(t_ft_ping *app);
+void		targets_init(t_ft_ping *app);
+void		target_next_seq(t_ft_ping *app, t_target *target, uint16_t seq,
+			struct timeval sent);
+void		target_set_address(t_target *target, struct in_addr addr);
+void		target_finish(t_ft_ping *app, t_target *target);
+t_target	*target_lookup(t_ft_ping *app, uint16_t id, in_addr_t addr);
+t_target	*target_from_error(t_ft_ping *app, const t_packet *pkt);
+
+/***** RESOLVER *****/
+void	resolver_start(t_ft_ping *app);
+void	resolver_watch(t_ft_ping *app);
+void	resolver_poll(t_ft_ping *app);
+void	resolver_refresh(t_ft_ping *app);
+void	resolver_destroy(t_resolver *resolver);
+int		resolver_fd(t_resolver *resolver);
+
+/***** ADDRESS CACHE *****/
+t_addr_cache	*addr_cache_init(bool rdns);
+const char		*addr_cache_lookup(t_addr_cache *cache, in_addr_t addr);
+void			addr_cache_poll(t_addr_cache *cache);
+void			addr_cache_destroy(t_addr_cache *cache);
 
 /***** PRINT *****/
-void	print_start_message(t_ft_ping *app);
-void	print_echo(int psize, t_ip_header *ip_header, int rcv_seq,
+void	print_start_message(t_ft_ping *app, t_target *target);
+void	print_echo(int psize, const t_ip_header *ip_header, int rcv_seq,
 	long long time, int dup);
-void	packet_dump(uint8_t *bytes, size_t len);
+void	packet_dump(const uint8_t *bytes, size_t len);
+void	datagram_dump(const t_ip_header *ip, size_t len, const uint8_t *data);
 void	print_help(char *prog_name);
 void	print_usage(char *prog_name);
 void	print_credits();
 void	print_exit_message(t_ft_ping *app);
+void	print_wrong_byte(t_ft_ping *app, const t_packet *pkt, int offset);
 
 /***** PARSE *****/
 void	parse_args(int ac, char **av, t_ft_ping *app);
@@ -150,40 +772,183 @@ void	calculate_timeout_remaining(struct timeval *timeout,
 
 /***** UTILS *****/
 long long	elapsed_time(struct timeval start, struct timeval end);
+uint64_t	timeval_usec(struct timeval tv);
+time_t		monotonic_seconds(void);
+
+/***** CLOCK *****/
+void	clock_real_init(t_clock *clock);
+void	clock_virtual_init(t_clock *clock);
+void	clock_now(struct timeval *tv);
 
 /***** PACKET *****/
 void		prepare_echo_request_packet(void *payload, uint8_t *sendbuffer,
 			int seq, pid_t pid);
-uint32_t	calculate_checksum(uint16_t *data, uint32_t len);
-int			send_packet(int sock, uint8_t *sendbuffer,
+uint32_t	calculate_checksum(const uint16_t *data, uint32_t len);
+int			send_packet(t_transport *transport, uint8_t *sendbuffer, size_t len,
 			struct sockaddr_in *addr);
-int			receive_packet(int sock, uint8_t *recvbuffer, size_t bufsize,
-			struct sockaddr_in *reply_addr, struct timeval *kernel_time);
-void		process_packet(int bytes, t_ft_ping *app, int rcv_seq);
+int			send_packet_ttl(t_transport *transport, uint8_t *sendbuffer,
+			size_t len, struct sockaddr_in *addr, int ttl);
+int			receive_packet(t_transport *transport, uint8_t *recvbuffer,
+			size_t bufsize, struct sockaddr_in *reply_addr,
+			struct timeval *kernel_time);
+void		process_packet(t_ft_ping *app, const t_packet *pkt);
 
 /***** PING *****/
-void	print_icmp_error(t_ip_header *ip_header, t_icmp_header *icmp_header, 
-			int bytes, t_ft_ping *app);
-void	ping_success(t_ip_header *ip_header, t_ft_ping *app, int rcv_seq);
+void	print_icmp_error(const t_packet *pkt, t_ft_ping *app);
+void	update_stats(t_target *target, long long time);
+void	ping_success(t_ft_ping *app, t_target *target, const t_packet *pkt);
+void	send_echo(t_ft_ping *app, t_target *target);
+void	prepare_payload(void *payload, int size, struct timeval *stamp);
+void	ping_start_target(t_ft_ping *app, t_target *target);
 int		ping_loop(t_ft_ping *app);
 int		ping_timeout(struct timeval *start_time, int timeout);
 
+/***** TRACE *****/
+void	trace_init(t_ft_ping *app);
+void	trace_start(t_ft_ping *app, t_target *target);
+void	trace_send_round(t_ft_ping *app);
+void	trace_process(t_ft_ping *app, const t_packet *pkt);
+void	trace_report(t_ft_ping *app);
+
+/***** PMTU *****/
+void	pmtu_init(t_ft_ping *app);
+void	pmtu_set_socket_options(int raw_socket);
+void	pmtu_start(t_ft_ping *app, t_target *target);
+void	pmtu_send_round(t_ft_ping *app);
+void	pmtu_tick(t_ft_ping *app);
+void	pmtu_process(t_ft_ping *app, const t_packet *pkt);
+void	pmtu_report(t_ft_ping *app);
+
+/***** SWEEP *****/
+bool	sweep_is_range(const char *hostname);
+void	sweep_init(t_ft_ping *app);
+void	sweep_set_socket_options(int raw_socket);
+void	sweep_start(t_ft_ping *app, t_target *target);
+void	sweep_tick(t_ft_ping *app);
+void	sweep_process(t_ft_ping *app, const t_packet *pkt);
+void	sweep_report(t_ft_ping *app);
+void	sweep_destroy(t_sweep *sweep);
+
+/***** TRANSPORT *****/
+void	transport_raw_init(t_transport *transport, int raw_socket);
+void	transport_hdrincl_init(t_transport *transport, int raw_socket,
+		t_ip_template *tmpl);
+bool	transport_ready(t_transport *transport, fd_set *fdset);
+void	simnet_init(t_transport *transport, const char *spec,
+		bool virtual_clock);
+void	pcap_attach(t_transport *transport, const char *path, int ttl);
+
+/***** FLOOD *****/
+void	flood_sent(t_target *target);
+void	flood_reply(t_target *target, uint16_t rcv_seq);
+void	flood_fill(t_ft_ping *app, t_target *target);
+
+/***** DEADLINES *****/
+void	deadline_push(t_ft_ping *app, t_target *target);
+bool	deadline_late(t_ft_ping *app, t_target *target, int slot);
+void	deadline_expire(t_ft_ping *app, struct timeval now);
+void	deadline_wait(t_ft_ping *app, struct timeval *timeout);
+
+/***** PAYLOAD *****/
+void	payload_fill(t_ft_ping *app);
+int		payload_check(t_ft_ping *app, const t_packet *pkt);
+
+/***** LOSS *****/
+void	jitter_update(t_loss_stats *loss, long long rtt);
+void	loss_advance(t_ft_ping *app, t_target *target, int upto);
+void	loss_report(t_ft_ping *app, t_target *target);
+
+/***** SERIES *****/
+void	series_init(t_ft_ping *app);
+void	series_sent(t_series *series, time_t now, int count);
+void	series_reply(t_series *series, time_t now, long long usec);
+void	series_dump(t_ft_ping *app);
+
+/***** LOW LATENCY *****/
+void	lowlat_init(t_ft_ping *app);
+int		lowlat_spin(int maxfd, fd_set *fdset, struct timeval *timeout);
+void	overhead_rx(t_ft_ping *app);
+void	overhead_tx(t_ft_ping *app, struct timeval sent);
+void	overhead_report(t_ft_ping *app);
+
+/***** SKETCH *****/
+void	sketch_add(t_sketch *sketch, long long usec);
+void	sketch_merge(t_sketch *dst, const t_sketch *src);
+double	sketch_quantile(const t_sketch *sketch, double q);
+void	sketch_print(const t_sketch *sketch);
+void	sketch_save(FILE *file, const char *name, const t_sketch *sketch);
+void	sketch_save_targets(t_ft_ping *app);
+int		sketch_merge_files(char **paths, int count);
+
+/***** REPLAY *****/
+int		replay_run(t_ft_ping *app);
+
 /***** IP *****/
-char	*ip_get_source_addr(t_ip_header *ip_header);
-int		ip_is_valid(uint8_t *packet, size_t len);
+const char	*ip_get_source_addr(const t_ip_header *ip_header);
+int		ip_is_valid(const uint8_t *packet, size_t len);
+void	ip_template_init(t_ip_template *tmpl, uint8_t tos, bool df, uint8_t ttl,
+		uint16_t first_id);
+void	ip_template_fill(t_ip_template *tmpl, t_ip_header *ip, size_t len,
+		in_addr_t daddr, int ttl);
 
 /***** ICMP *****/
-uint16_t		icmp_get_sequence(t_icmp_header *icmp_header);
-int16_t			buffer_get_sequence(uint8_t *buffer, size_t len);
-int				verify_checksum(uint16_t *data, uint32_t len);
-uint8_t			*extract_embedded_packet(uint8_t *error_packet,
-			int *embedded_len);
-t_icmp_header	*icmp_get_header(uint8_t *buffer, size_t len);
+bool			packet_parse(const uint8_t *buffer, size_t len, t_packet *pkt);
+int				verify_checksum(const uint16_t *data, uint32_t len);
+
+/***** ARENA *****/
+void	arena_init(t_arena *arena, size_t size);
+void	*arena_alloc(t_arena *arena, size_t size);
+void	arena_destroy(t_arena *arena);
+
+/***** PROFILER *****/
+# ifdef FT_PING_PROFILE
+void	prof_record(t_prof_stage stage, uint64_t cycles);
+void	prof_report(void);
+
+/* TSC where there is one (constant rate, ~20 cycles), else nanoseconds */
+static inline uint64_t	prof_cycles(void)
+{
+#  if defined(__x86_64__) || defined(__i386__)
+	return (__rdtsc());
+#  else
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#  endif
+}
+
+#  define PROF_START(var)		uint64_t var = prof_cycles()
+#  define PROF_STOP(stage, var)	prof_record(stage, prof_cycles() - (var))
+#  define PROF_REPORT()			prof_report()
+# else
+#  define PROF_START(var)		((void)0)
+#  define PROF_STOP(stage, var)	((void)0)
+#  define PROF_REPORT()			((void)0)
+# endif
+
+/**
+ * USDT probes, provider ft_ping, for bpftrace / perf / systemtap:
+ *   echo_send(id, seq, daddr, sent_usec)     after the request left
+ *   echo_reply(id, seq, rtt_usec, ttl)       first reply to a probe
+ *   echo_dup(id, seq, rtt_usec)              any later copy
+ *   icmp_error(type, code, id, seq)          classified error, id 0 if not ours
+ *   stats_update(id, received, rtt_usec, avg_usec)
+ * Each is a single nop plus an ELF note until a tracer attaches. Without
+ * <sys/sdt.h> (or with FT_PING_NO_USDT) they compile to nothing.
+ */
+# ifdef FT_PING_USDT
+#  define USDT3(name, a, b, c)		DTRACE_PROBE3(ft_ping, name, a, b, c)
+#  define USDT4(name, a, b, c, d)	DTRACE_PROBE4(ft_ping, name, a, b, c, d)
+# else
+#  define USDT3(name, a, b, c)		((void)0)
+#  define USDT4(name, a, b, c, d)	((void)0)
+# endif
 
 /***** BITMAP ****/
-void	bitmap_set(uint8_t *bitmap, uint16_t n);
-int		bitmap_test(uint8_t *bitmap, uint16_t n);
-void	bitmap_clear(uint8_t *bitmap, uint16_t n);
+void	bitmap_set(uint8_t *bitmap, uint32_t n);
+int		bitmap_test(uint8_t *bitmap, uint32_t n);
+void	bitmap_clear(uint8_t *bitmap, uint32_t n);
 
 /***** DEBUG *****/
 void		print_bytes(uint8_t *bytes, size_t len, char *header);
@@ -0,0 +1,213 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   addr_cache.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:04:03 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 16:04:03 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* Fibonacci hashing: consecutive addresses land far apart */
+static size_t	addr_hash(in_addr_t addr)
+{
+	return (((uint32_t)addr * 2654435761u) >> (32 - ADDR_CACHE_BITS));
+}
+
+static void	*ptr_worker(void *arg)
+{
+	t_addr_cache		*cache;
+	struct sockaddr_in	sa;
+	t_ptr_result		result;
+
+	cache = arg;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	pthread_mutex_lock(&cache->lock);
+	while (1)
+	{
+		while (!cache->shutdown && cache->q_len == 0)
+			pthread_cond_wait(&cache->cond, &cache->lock);
+		if (cache->shutdown)
+			break ;
+		result.addr = cache->queue[cache->q_head];
+		cache->q_head = (cache->q_head + 1) % PTR_QUEUE_SIZE;
+		cache->q_len--;
+		pthread_mutex_unlock(&cache->lock);
+		sa.sin_addr.s_addr = result.addr;
+		if (getnameinfo((struct sockaddr *)&sa, sizeof(sa), result.name,
+				sizeof(result.name), NULL, 0, NI_NAMEREQD) != 0)
+			result.name[0] = '\0';
+		pthread_mutex_lock(&cache->lock);
+		cache->done[(cache->d_head + cache->d_len) % PTR_QUEUE_SIZE] = result;
+		cache->d_len++;
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return (NULL);
+}
+
+/**
+ * Allocates the reply address cache. With rdns, a background thread looks
+ * up PTR names; until one is known the numeric address is printed.
+ */
+t_addr_cache	*addr_cache_init(bool rdns)
+{
+	t_addr_cache	*cache;
+	sigset_t		all, old;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+	{
+		perror("ft_ping: addr cache");
+		exit(1);
+	}
+	if (!rdns)
+		return (cache);
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->cond, NULL);
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	cache->rdns = pthread_create(&cache->thread, NULL, ptr_worker,
+			cache) == 0;
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (!cache->rdns)
+		fprintf(stderr, "ft_ping: reverse lookups disabled\n");
+	return (cache);
+}
+
+static void	ptr_request(t_addr_cache *cache, t_addr_entry *entry)
+{
+	// Bounded: when too many lookups are in flight, retry on a later reply
+	if (cache->outstanding >= PTR_QUEUE_SIZE)
+		return ;
+	pthread_mutex_lock(&cache->lock);
+	cache->queue[(cache->q_head + cache->q_len) % PTR_QUEUE_SIZE]
+		= entry->addr;
+	cache->q_len++;
+	pthread_cond_signal(&cache->cond);
+	pthread_mutex_unlock(&cache->lock);
+	cache->outstanding++;
+	entry->ptr = PTR_PENDING;
+}
+
+static t_addr_entry	*addr_cache_find(t_addr_cache *cache, in_addr_t addr)
+{
+	size_t	home;
+	size_t	slot;
+	int		i;
+
+	home = addr_hash(addr);
+	for (i = 0; i < ADDR_CACHE_PROBES; i++)
+	{
+		slot = (home + i) & (ADDR_CACHE_SIZE - 1);
+		if (cache->entries[slot].used && cache->entries[slot].addr == addr)
+			return (&cache->entries[slot]);
+		if (!cache->entries[slot].used)
+			return (NULL);
+	}
+	return (NULL);
+}
+
+/**
+ * Returns the preformatted source text for addr ("a.b.c.d", or
+ * "name (a.b.c.d)" once its PTR is known). A miss formats the address once;
+ * when the probe window is full the home slot is recycled, so slots never
+ * become empty again and the probe chains stay valid.
+ */
+const char	*addr_cache_lookup(t_addr_cache *cache, in_addr_t addr)
+{
+	t_addr_entry	*entry;
+	size_t			home;
+	size_t			slot;
+	int				i;
+
+	home = addr_hash(addr);
+	entry = &cache->entries[home];
+	for (i = 0; i < ADDR_CACHE_PROBES; i++)
+	{
+		slot = (home + i) & (ADDR_CACHE_SIZE - 1);
+		if (!cache->entries[slot].used || cache->entries[slot].addr == addr)
+		{
+			entry = &cache->entries[slot];
+			break ;
+		}
+	}
+	if (!entry->used || entry->addr != addr)
+	{
+		entry->used = true;
+		entry->addr = addr;
+		entry->ptr = PTR_NONE;
+		inet_ntop(AF_INET, &addr, entry->text, sizeof(entry->text));
+	}
+	if (cache->rdns && entry->ptr == PTR_NONE)
+		ptr_request(cache, entry);
+	return (entry->text);
+}
+
+/* "name (a.b.c.d)". Names that don't fit keep the numeric form. */
+static void	addr_entry_set_name(t_addr_entry *entry, const char *name)
+{
+	char	ip[INET_ADDRSTRLEN];
+	size_t	name_len;
+	size_t	ip_len;
+
+	inet_ntop(AF_INET, &entry->addr, ip, sizeof(ip));
+	name_len = strlen(name);
+	ip_len = strlen(ip);
+	if (name_len + ip_len + 4 > sizeof(entry->text))
+		return ;
+	memcpy(entry->text, name, name_len);
+	memcpy(entry->text + name_len, " (", 2);
+	memcpy(entry->text + name_len + 2, ip, ip_len);
+	memcpy(entry->text + name_len + 2 + ip_len, ")", 2);
+}
+
+/* Apply PTR names resolved since the last call. Cheap when nothing is due. */
+void	addr_cache_poll(t_addr_cache *cache)
+{
+	t_ptr_result	result;
+	t_addr_entry	*entry;
+
+	if (!cache->rdns)
+		return ;
+	while (1)
+	{
+		pthread_mutex_lock(&cache->lock);
+		if (cache->d_len == 0)
+		{
+			pthread_mutex_unlock(&cache->lock);
+			return ;
+		}
+		result = cache->done[cache->d_head];
+		cache->d_head = (cache->d_head + 1) % PTR_QUEUE_SIZE;
+		cache->d_len--;
+		pthread_mutex_unlock(&cache->lock);
+		cache->outstanding--;
+		entry = addr_cache_find(cache, result.addr);
+		if (!entry)
+			continue ; // Evicted while resolving
+		entry->ptr = PTR_DONE;
+		if (result.name[0])
+			addr_entry_set_name(entry, result.name);
+	}
+}
+
+void	addr_cache_destroy(t_addr_cache *cache)
+{
+	if (cache->rdns)
+	{
+		pthread_mutex_lock(&cache->lock);
+		cache->shutdown = true;
+		pthread_cond_signal(&cache->cond);
+		pthread_mutex_unlock(&cache->lock);
+		pthread_join(cache->thread, NULL);
+		pthread_mutex_destroy(&cache->lock);
+		pthread_cond_destroy(&cache->cond);
+	}
+	free(cache);
+}
@@ -0,0 +1,52 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   arena.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:02:06 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 18:02:06 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* One zeroed block for `size` bytes of allocations, exits on failure */
+void	arena_init(t_arena *arena, size_t size)
+{
+	arena->block = calloc(1, size + ARENA_ALIGN);
+	if (!arena->block)
+	{
+		perror("ft_ping: calloc");
+		exit(1);
+	}
+	arena->base = (uint8_t *)(((uintptr_t)arena->block + ARENA_ALIGN - 1)
+			& ~(uintptr_t)(ARENA_ALIGN - 1));
+	arena->size = size;
+	arena->used = 0;
+}
+
+/* Next `size` bytes, cache line aligned. The caller sized the arena, so
+running out is a bug */
+void	*arena_alloc(t_arena *arena, size_t size)
+{
+	void	*ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (arena->used + size > arena->size)
+	{
+		fprintf(stderr, "ft_ping: arena: out of memory\n");
+		exit(1);
+	}
+	ptr = arena->base + arena->used;
+	arena->used += size;
+	return (ptr);
+}
+
+void	arena_destroy(t_arena *arena)
+{
+	free(arena->block);
+	memset(arena, 0, sizeof(*arena));
+}
@@ -12,7 +12,7 @@
 
 #include "ft_ping.h"
 
-void	bitmap_set(uint8_t *bitmap, uint16_t n)
+void	bitmap_set(uint8_t *bitmap, uint32_t n)
 {
 	int	index;
 	int	offset;
@@ -22,7 +22,7 @@ void	bitmap_set(uint8_t *bitmap, uint16_t n)
 	bitmap[index] |= (1 << offset);
 }
 
-int	bitmap_test(uint8_t *bitmap, uint16_t n)
+int	bitmap_test(uint8_t *bitmap, uint32_t n)
 {
 	int	index;
 	int	offset;
@@ -32,7 +32,7 @@ int	bitmap_test(uint8_t *bitmap, uint16_t n)
 	return ((bitmap[index] & (1 << offset)) != 0);
 }
 
-void	bitmap_clear(uint8_t *bitmap, uint16_t n)
+void	bitmap_clear(uint8_t *bitmap, uint32_t n)
 {
 	int	index;
 	int	offset;
@@ -0,0 +1,79 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   clock.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 11:37:16 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 11:37:16 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+static void	real_read(t_clock *clock, struct timeval *tv)
+{
+	(void)clock;
+	gettimeofday(tv, NULL);
+}
+
+static int	real_wait(t_clock *clock, int maxfd, fd_set *fdset,
+		struct timeval *timeout)
+{
+	(void)clock;
+	return (select(maxfd + 1, fdset, NULL, NULL, timeout));
+}
+
+static void	virtual_read(t_clock *clock, struct timeval *tv)
+{
+	*tv = clock->now;
+}
+
+/* Whatever is already readable comes first and takes no time; otherwise
+the whole timeout elapses at once, like a select() nothing woke up */
+static int	virtual_wait(t_clock *clock, int maxfd, fd_set *fdset,
+		struct timeval *timeout)
+{
+	struct timeval	zero;
+	int				ready;
+
+	if (maxfd >= 0)
+	{
+		timerclear(&zero);
+		ready = select(maxfd + 1, fdset, NULL, NULL, &zero);
+		if (ready != 0)
+			return (ready);
+	}
+	timeradd(&clock->now, timeout, &clock->now);
+	timerclear(timeout);
+	return (0);
+}
+
+void	clock_real_init(t_clock *clock)
+{
+	memset(clock, 0, sizeof(*clock));
+	clock->name = "real";
+	clock->read = real_read;
+	clock->wait = real_wait;
+}
+
+/* Starts at VIRTUAL_EPOCH so that two runs print the same times */
+void	clock_virtual_init(t_clock *clock)
+{
+	memset(clock, 0, sizeof(*clock));
+	clock->name = "virtual";
+	clock->now.tv_sec = VIRTUAL_EPOCH;
+	clock->read = virtual_read;
+	clock->wait = virtual_wait;
+}
+
+/* gettimeofday() through the clock in use */
+void	clock_now(struct timeval *tv)
+{
+	if (g_ft_ping && g_ft_ping->clock.read)
+		g_ft_ping->clock.read(&g_ft_ping->clock, tv);
+	else
+		gettimeofday(tv, NULL);
+}
@@ -0,0 +1,148 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   deadline.c                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:25:38 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 15:25:38 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_ping.h"
+
+/**
+ * -W: every echo request gets a deadline. All probes share the same wait,
+ * so deadlines expire in send order: a FIFO ring of (target, sequence)
+ * holds them, pushed on send and popped once due. Replies never touch it,
+ * the dup window tells at pop time whether the probe was answered.
+ * One push and one pop per probe, whatever the rate or number of hosts.
+ */
+
+static void	deadline_grow(t_deadlines *deadlines)
+{
+	t_deadline	*ring;
+	size_t		cap;
+	size_t		i;
+
+	cap = deadlines->cap ? deadlines->cap * 2 : DEADLINE_RING_MIN;
+	ring = malloc(cap * sizeof(*ring));
+	if (!ring)
+	{
+		perror("ft_ping: deadlines");
+		exit(1);
+	}
+	for (i = 0; i < deadlines->len; i++)
+		ring[i] = deadlines->ring[(deadlines->head + i)
+			& (deadlines->cap - 1)];
+	free(deadlines->ring);
+	deadlines->ring = ring;
+	deadlines->cap = cap;
+	deadlines->head = 0;
+}
+
+/* Called right after target_next_seq, the send time is in the table */
+void	deadline_push(t_ft_ping *app, t_target *target)
+{
+	t_deadlines	*deadlines;
+	t_deadline	*deadline;
+
+	deadlines = &app->deadlines;
+	if (deadlines->len == deadlines->cap)
+		deadline_grow(deadlines);
+	deadline = &deadlines->ring[(deadlines->head + deadlines->len)
+		& (deadlines->cap - 1)];
+	deadline->target = target - app->targets;
+	deadline->seq = target->sequence;
+	deadlines->len++;
+}
+
+/* A reply arriving after its deadline: counted apart, not as received */
+bool	deadline_late(t_ft_ping *app, t_target *target, int slot)
+{
+	if ((uint32_t)((uint32_t)timeval_usec(app->end) - target->send_times[slot])
+		<= app->options[LINGER] * 1000U)
+		return (false);
+	target->late_packets++;
+	return (true);
+}
+
+static void	deadline_missed(t_ft_ping *app, t_target *target, uint16_t seq)
+{
+	if (app->options[QUIET] || app->options[FLOOD])
+		return ;
+	printf("Request timeout for icmp_seq=%d", seq);
+	if (app->target_count > 1)
+		printf(" to %s", target->info->ip_str);
+	printf("\n");
+}
+
+/* Once the last probe of a COUNT run is past its deadline, replies that
+didn't come can't come any more: the target is done */
+static void	deadline_last(t_ft_ping *app, t_target *target, uint16_t seq)
+{
+	if (app->options[COUNT] && target->sent_packets >= app->options[COUNT]
+		&& seq == (uint16_t)(target->sent_packets - 1)
+		&& target->rcv_packets < app->options[COUNT])
+		target_finish(app, target);
+}
+
+/**
+ * Pops every deadline already passed at `now`, reporting the probes still
+ * unanswered. A probe the dup window has moved past can't be told apart
+ * any more and is dropped silently.
+ */
+void	deadline_expire(t_ft_ping *app, struct timeval now)
+{
+	t_deadlines	*deadlines;
+	t_deadline	*deadline;
+	t_target	*target;
+	uint32_t	usec;
+	int			slot;
+
+	deadlines = &app->deadlines;
+	usec = timeval_usec(now);
+	while (deadlines->len)
+	{
+		deadline = &deadlines->ring[deadlines->head];
+		target = &app->targets[deadline->target];
+		slot = deadline->seq & (app->dup_window - 1);
+		if ((uint16_t)(target->sequence - deadline->seq) < app->dup_window)
+		{
+			if (usec - target->send_times[slot]
+				<= app->options[LINGER] * 1000U)
+				break ;
+			if (!bitmap_test(target->rcv_map, slot))
+				deadline_missed(app, target, deadline->seq);
+			deadline_last(app, target, deadline->seq);
+		}
+		deadlines->head = (deadlines->head + 1) & (deadlines->cap - 1);
+		deadlines->len--;
+	}
+}
+
+/* Shortens the wait to the next deadline */
+void	deadline_wait(t_ft_ping *app, struct timeval *timeout)
+{
+	t_deadline		*deadline;
+	t_target		*target;
+	struct timeval	now;
+	long long		left;
+
+	if (!app->deadlines.len)
+		return ;
+	deadline = &app->deadlines.ring[app->deadlines.head];
+	target = &app->targets[deadline->target];
+	clock_now(&now);
+	// Due once strictly past, a reply right on time is still on time
+	left = app->options[LINGER] * 1000LL + 1 - (uint32_t)((uint32_t)timeval_usec(now)
+			- target->send_times[deadline->seq & (app->dup_window - 1)]);
+	if (left < 0)
+		left = 0;
+	if ((uint64_t)left < timeval_usec(*timeout))
+	{
+		timeout->tv_sec = left / 1000000;
+		timeout->tv_usec = left % 1000000;
+	}
+}
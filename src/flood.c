@@ -0,0 +1,91 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   flood.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 13:49:37 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 13:49:37 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_ping.h"
+
+/**
+ * Reply driven flood (-f): up to --window probes per target are in flight,
+ * a new one leaves as soon as a reply frees a slot or the oldest probe
+ * times out. Probes [oldest, next sequence) are the candidates, in send
+ * order, so timeouts are found at the front: constant work per probe.
+ */
+
+/* -W when given. Else like a TCP RTO: 1 s before any reply, then avg +
+4 stddev, at least 10 ms so a lossy flood still sends 100 probes a second
+like iputils */
+static long long	flood_timeout(t_ft_ping *app, t_target *target)
+{
+	long long	rto;
+
+	if (app->options[LINGER])
+		return (app->options[LINGER] * 1000LL);
+	if (target->rcv_packets == 0)
+		return (FLOOD_INITIAL_RTO);
+	rto = target->stats[AVG] + 4 * target->stats[STDDEV];
+	if (rto < FLOOD_MIN_RTO)
+		rto = FLOOD_MIN_RTO;
+	return (rto);
+}
+
+/**
+ * Frees the slots of probes past their timeout, and skips answered ones.
+ * A probe half a dup window behind is given up whatever its age: its bit
+ * is about to be reused.
+ */
+static void	flood_expire(t_ft_ping *app, t_target *target, uint32_t now)
+{
+	uint16_t	next;
+	uint32_t	rto;
+	int			slot;
+
+	next = target->sent_packets;
+	rto = flood_timeout(app, target);
+	while (target->oldest != next)
+	{
+		slot = target->oldest & (app->dup_window - 1);
+		if (!bitmap_test(target->rcv_map, slot))
+		{
+			if (now - target->send_times[slot] < rto
+				&& (uint16_t)(next - target->oldest) < app->dup_window / 2)
+				break ;
+			target->in_flight--;
+		}
+		target->oldest++;
+	}
+}
+
+void	flood_sent(t_target *target)
+{
+	target->in_flight++;
+}
+
+/* First reply to rcv_seq: its slot is free unless it already timed out */
+void	flood_reply(t_target *target, uint16_t rcv_seq)
+{
+	if ((uint16_t)(rcv_seq - target->oldest)
+		< (uint16_t)(target->sent_packets - target->oldest))
+		target->in_flight--;
+}
+
+/* Send until the window is full again (or COUNT is reached) */
+void	flood_fill(t_ft_ping *app, t_target *target)
+{
+	struct timeval	now;
+
+	clock_now(&now);
+	flood_expire(app, target, timeval_usec(now));
+	while (target->in_flight < app->options[WINDOW] && !app->stop
+		&& target->state == TARGET_READY
+		&& !(app->options[COUNT]
+			&& target->sent_packets >= app->options[COUNT]))
+		send_echo(app, target);
+}
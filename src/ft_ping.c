@@ -18,13 +18,23 @@ void	clean_up()
 {
 	if (!g_ft_ping)
 		return ;
-	// Only print exit message if we actually started pinging (sent at least one packet)
-	if (g_ft_ping->sent_packets > 0)
+	// Only targets we actually started pinging print their statistics
+	if (g_ft_ping->targets)
 		print_exit_message(g_ft_ping);
-	if (g_ft_ping->socket > 0)
-		close(g_ft_ping->socket);
-	if (g_ft_ping->res)
-		freeaddrinfo(g_ft_ping->res);
+	PROF_REPORT();
+	if (g_ft_ping->transport.close)
+		g_ft_ping->transport.close(&g_ft_ping->transport);
+	if (g_ft_ping->resolver)
+		resolver_destroy(g_ft_ping->resolver);
+	if (g_ft_ping->addr_cache)
+		addr_cache_destroy(g_ft_ping->addr_cache);
+	free(g_ft_ping->series);
+	free(g_ft_ping->deadlines.ring);
+	free(g_ft_ping->trace);
+	free(g_ft_ping->pmtu);
+	if (g_ft_ping->sweep)
+		sweep_destroy(g_ft_ping->sweep);
+	arena_destroy(&g_ft_ping->arena);
 	g_ft_ping = NULL;
 }
 
@@ -34,12 +44,19 @@ void	interrupt(int signum)
 	g_ft_ping->stop = 1;
 }
 
+void	request_dump(int signum)
+{
+	(void) signum;
+	g_ft_ping->dump = 1;
+}
+
 static void	init_app(t_ft_ping *app)
 {
 	memset(app, 0, sizeof(*app));
 	app->pid = getpid();
-	app->socket = -1; // at 0 the cleanup might close stdin
+	app->transport.fd = -1; // at 0 the cleanup might close stdin
 	app->packet_size = PACKET_SIZE;
+	clock_real_init(&app->clock);
 }
 
 int	main(int ac, char **av)
@@ -50,8 +67,29 @@ int	main(int ac, char **av)
 	g_ft_ping = &app;
 	atexit(clean_up); // clean up when exit() is called
 	parse_args(ac, av, &app);
+	if (app.options[MERGE_SKETCH])
+		return (sketch_merge_files(app.hostnames, app.target_count));
+	if (app.options[VIRTUAL_CLOCK])
+		clock_virtual_init(&app.clock);
+	payload_fill(&app);
+	if (app.series_path)
+		series_init(&app);
+	if (app.options[REPLAY])
+	{
+		app.addr_cache = addr_cache_init(app.options[RDNS]);
+		return (replay_run(&app));
+	}
+	if (sweep_is_range(app.hostnames[0]))
+		sweep_init(&app);
+	targets_init(&app);
+	app.addr_cache = addr_cache_init(app.options[RDNS]);
+	if (app.options[TRACE])
+		trace_init(&app);
+	if (app.options[PMTU])
+		pmtu_init(&app);
 	setup_destination(&app);
 	init_socket(&app);
-	print_start_message(&app);
+	if (app.options[LOW_LATENCY])
+		lowlat_init(&app);
 	return (ping_loop(&app));
 }
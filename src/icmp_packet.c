@@ -12,54 +12,65 @@
 
 #include "ft_ping.h"
 
-/* Returns the sequence number from an icmp packet checking its type */
-uint16_t	icmp_get_sequence(t_icmp_header *icmp_header)
+/**
+ * Our echo request embedded in an ICMP error (RFC 792: original IP header
+ * + first 8 bytes of the datagram). Left unset when it's truncated or not an
+ * echo request.
+ */
+static void	packet_parse_orig(t_packet *pkt)
 {
-	struct icmp		*icmp_bsd;
-	struct ip		*ip;
-	int				ip_hlen;
-	struct icmp		*icmp;
+	const t_ip_header	*ip;
+	const t_icmp_header	*orig;
+	int					hlen;
 
-	if (icmp_header->type == ICMP_ECHOREPLY || icmp_header->type == ICMP_ECHO)
-		return (ntohs(icmp_header->un.echo.sequence));
-	icmp_bsd = (struct icmp *) icmp_header;
-	ip = &icmp_bsd->icmp_ip;
-	ip_hlen = ip->ip_hl << 2;
-	icmp = (struct icmp *)((uint8_t *)ip + ip_hlen);
-	return (ntohs(icmp->icmp_seq));
-}
-
-int16_t	buffer_get_sequence(uint8_t *buffer, size_t len)
-{
-	t_icmp_header	*icmp_header;
-
-	icmp_header = icmp_get_header(buffer, len);
-	if (!icmp_header)
-		return (-1);
-	return ((int16_t)icmp_get_sequence(icmp_header));
+	if (pkt->payload_len < (int)sizeof(t_ip_header) + ICMP_HEADER_SIZE)
+		return ;
+	ip = (const t_ip_header *)pkt->payload;
+	hlen = ip->ihl << 2;
+	if (hlen < (int)sizeof(t_ip_header)
+		|| pkt->payload_len < hlen + ICMP_HEADER_SIZE
+		|| ip->protocol != IPPROTO_ICMP)
+		return ;
+	orig = (const t_icmp_header *)(pkt->payload + hlen);
+	if (orig->type != ICMP_ECHO)
+		return ;
+	pkt->has_orig = true;
+	pkt->orig_id = ntohs(orig->un.echo.id);
+	pkt->orig_daddr = ip->daddr;
+	pkt->seq = ntohs(orig->un.echo.sequence);
 }
 
-t_icmp_header	*icmp_get_header(uint8_t *buffer, size_t len)
+/**
+ * The one pass over a received IP datagram of len bytes: false when it can't
+ * hold an ICMP header. The checksum is verified in place, nothing is written.
+ */
+bool	packet_parse(const uint8_t *buffer, size_t len, t_packet *pkt)
 {
-	t_ip_header		*ip_header;
-	int				offset;
+	int	hlen;
 
 	if (!ip_is_valid(buffer, len))
-		return (NULL);
-	ip_header = (t_ip_header *)buffer;
-	offset = ip_header->ihl * 4;
-	return ((t_icmp_header *)(buffer + offset));
-}
-
-uint8_t	*extract_embedded_packet(uint8_t *error_packet, int *embedded_len)
-{
-	t_ip_header	*ip;
-	int			hlen;
-
-	ip = (t_ip_header *)error_packet;
-	hlen = ip->ihl << 2;
-	*embedded_len = *embedded_len - hlen - ICMP_HEADER_SIZE;
-	return (error_packet + hlen + ICMP_HEADER_SIZE);
+		return (false);
+	hlen = ((const t_ip_header *)buffer)->ihl << 2;
+	if (len < (size_t)hlen + ICMP_HEADER_SIZE)
+		return (false);
+	memset(pkt, 0, sizeof(*pkt));
+	pkt->ip = (const t_ip_header *)buffer;
+	pkt->icmp = (const t_icmp_header *)(buffer + hlen);
+	pkt->len = len - hlen;
+	pkt->payload = buffer + hlen + ICMP_HEADER_SIZE;
+	pkt->payload_len = pkt->len - ICMP_HEADER_SIZE;
+	pkt->type = pkt->icmp->type;
+	pkt->code = pkt->icmp->code;
+	pkt->ttl = pkt->ip->ttl;
+	pkt->checksum_ok = verify_checksum((const uint16_t *)pkt->icmp, pkt->len);
+	if (pkt->type == ICMP_ECHOREPLY || pkt->type == ICMP_ECHO)
+	{
+		pkt->id = ntohs(pkt->icmp->un.echo.id);
+		pkt->seq = ntohs(pkt->icmp->un.echo.sequence);
+	}
+	else
+		packet_parse_orig(pkt);
+	return (true);
 }
 
 void	prepare_echo_request_packet(void *payload, 
@@ -80,7 +91,7 @@ void	prepare_echo_request_packet(void *payload,
 	packet->checksum = calculate_checksum((uint16_t*) packet, packet_size);
 }
 
-uint32_t	calculate_checksum(uint16_t *data, uint32_t len)
+uint32_t	calculate_checksum(const uint16_t *data, uint32_t len)
 {
 	register long	sum;
 
@@ -91,22 +102,14 @@ uint32_t	calculate_checksum(uint16_t *data, uint32_t len)
 		len -= 2;
 	}
 	if (len > 0)
-		sum += *(uint8_t *)data;
+		sum += *(const uint8_t *)data;
 	while (sum >> 16)
 		sum = (sum & 0xffff) + (sum >> 16);
 	return (~sum);
 }
 
-int	verify_checksum(uint16_t *data, uint32_t len)
+/* The sum over the whole message, checksum field included, folds to 0xffff */
+int	verify_checksum(const uint16_t *data, uint32_t len)
 {
-	uint32_t		checksum_check;
-	uint32_t		checksum_rcv;
-	t_icmp_header	*icmp_header;
-	
-	icmp_header = (t_icmp_header *)data;
-	checksum_rcv = icmp_header->checksum & 0xffff;
-	icmp_header->checksum = 0;
-	checksum_check = calculate_checksum((uint16_t *)icmp_header, len) & 0xffff;
-	icmp_header->checksum = checksum_rcv;
-	return (checksum_rcv == checksum_check);
-}
\ No newline at end of file
+	return ((calculate_checksum(data, len) & 0xffff) == 0);
+}
@@ -12,22 +12,82 @@
 
 #include "ft_ping.h"
 
-char	*ip_get_source_addr(t_ip_header *ip_header)
+/* Printable source of a reply, served from the address cache when there is
+one (the cache returns the same pointer until the entry is recycled) */
+const char	*ip_get_source_addr(const t_ip_header *ip_header)
 {
 	struct in_addr addr;
 
+	if (g_ft_ping && g_ft_ping->addr_cache)
+		return (addr_cache_lookup(g_ft_ping->addr_cache, ip_header->saddr));
 	addr.s_addr = ip_header->saddr;
 	return (inet_ntoa(addr));
 }
 
-int	ip_is_valid(uint8_t *packet, size_t len)
+int	ip_is_valid(const uint8_t *packet, size_t len)
 {
-	t_ip_header	*ip_header;
+	const t_ip_header	*ip_header;
 
 	if (!packet || len < 20)
 		return (0);
-	ip_header = (t_ip_header *) packet;
+	ip_header = (const t_ip_header *) packet;
 	if (ip_header->ihl < 5 || len < ip_header->ihl * 4)
 		return (0);
 	return (1);
-}
\ No newline at end of file
+}
+/**
+ * Everything constant across probes is laid out, and checksummed, once:
+ * tot_len, id and daddr stay 0 so that each probe only adds its own values
+ * to the sum. The source is left 0 for the kernel to fill in.
+ */
+void	ip_template_init(t_ip_template *tmpl, uint8_t tos, bool df, uint8_t ttl,
+		uint16_t first_id)
+{
+	memset(tmpl, 0, sizeof(*tmpl));
+	tmpl->ip.version = 4;
+	tmpl->ip.ihl = sizeof(t_ip_header) / 4;
+	tmpl->ip.tos = tos;
+	tmpl->ip.frag_off = df ? htons(IP_DF) : 0;
+	tmpl->ip.ttl = ttl;
+	tmpl->ip.protocol = IPPROTO_ICMP;
+	tmpl->ip.check = calculate_checksum((const uint16_t *)&tmpl->ip,
+			sizeof(tmpl->ip));
+	tmpl->next_id = first_id;
+}
+
+/* One's complement sum folded to 16 bits */
+static uint16_t	fold(uint32_t sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return (sum);
+}
+
+/**
+ * The header of the next probe: len bytes of ICMP to daddr, with a TTL of
+ * its own when ttl is set. The checksum is updated from the template's
+ * (RFC 1624): a field going from 0 to m adds m, the TTL word adds
+ * ~old + new. IDs skip 0, which the kernel would replace.
+ */
+void	ip_template_fill(t_ip_template *tmpl, t_ip_header *ip, size_t len,
+		in_addr_t daddr, int ttl)
+{
+	uint32_t	sum;
+	uint16_t	old;
+
+	*ip = tmpl->ip;
+	if (!tmpl->next_id)
+		tmpl->next_id = 1;
+	ip->tot_len = htons(sizeof(*ip) + len);
+	ip->id = htons(tmpl->next_id++);
+	ip->daddr = daddr;
+	sum = (uint16_t)~tmpl->ip.check + ip->tot_len + ip->id
+		+ (daddr & 0xffff) + (daddr >> 16);
+	if (ttl && ttl != tmpl->ip.ttl)
+	{
+		old = *(uint16_t *)&ip->ttl;	// TTL and protocol share a word
+		ip->ttl = ttl;
+		sum += (uint16_t)~old + *(uint16_t *)&ip->ttl;
+	}
+	ip->check = ~fold(sum);
+}
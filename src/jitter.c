@@ -0,0 +1,130 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   jitter.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 15:56:18 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 15:56:18 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/**
+ * RFC 3550 6.4.1 interarrival jitter: D is the change in transit time of
+ * consecutive replies, which for an echo is the change of RTT; J moves by
+ * 1/16 of (|D| - J) on every reply.
+ */
+void	jitter_update(t_loss_stats *loss, long long rtt)
+{
+	long long	d;
+
+	if (loss->replies++)
+	{
+		d = rtt - loss->last_rtt;
+		if (d < 0)
+			d = -d;
+		loss->jitter += (d - loss->jitter) / 16.0;
+	}
+	loss->last_rtt = rtt;
+}
+
+/* Run lengths 1, 2, 3, 4, 5-8, 9-16, 17-32 and 33+ */
+static int	loss_run_bucket(int run)
+{
+	int	bucket;
+
+	if (run <= 4)
+		return (run - 1);
+	for (bucket = 4; run > 8 && bucket < LOSS_RUN_BUCKETS - 1; bucket++)
+		run = (run + 1) / 2;
+	return (bucket);
+}
+
+/* One more probe outcome, in sequence order */
+static void	loss_outcome(t_loss_stats *loss, bool lost)
+{
+	if (loss->settled)
+		loss->transitions[loss->last][lost]++;
+	loss->last = lost;
+	if (lost)
+		loss->run++;
+	else if (loss->run)
+	{
+		loss->runs[loss_run_bucket(loss->run)]++;
+		loss->run = 0;
+	}
+}
+
+/**
+ * Settles probes in sequence order up to `upto` (exclusive): a probe still
+ * unanswered settle_lag probes (LOSS_WINDOW, or the preload) after it left
+ * is lost, so reordered replies within the window are not mistaken for
+ * losses. O(1) amortized, called as probes are sent and once more for the
+ * summary.
+ */
+void	loss_advance(t_ft_ping *app, t_target *target, int upto)
+{
+	t_loss_stats	*loss;
+
+	loss = target->loss;
+	if (!loss)
+		return ;
+	while (loss->settled < upto)
+	{
+		loss_outcome(loss, !bitmap_test(target->rcv_map,
+				(uint16_t)(loss->first_seq + loss->settled)
+				& (app->dup_window - 1)));
+		loss->settled++;
+	}
+}
+
+/* Closes the trailing run, the summary is taken at the very end */
+static void	loss_finish(t_ft_ping *app, t_target *target)
+{
+	loss_advance(app, target, target->sent_packets);
+	if (target->loss->run)
+	{
+		target->loss->runs[loss_run_bucket(target->loss->run)]++;
+		target->loss->run = 0;
+	}
+}
+
+/*
+Example:
+jitter = 0.123 ms (RFC 3550)
+loss runs 1/2/3/4/5-8/9-16/17-32/33+ = 3/1/0/0/0/0/0/0
+gilbert-elliott p = 0.0120 r = 0.7500, mean burst 1.3, mean gap 83.3, loss 1.6%
+*/
+void	loss_report(t_ft_ping *app, t_target *target)
+{
+	t_loss_stats	*loss;
+	double			p;
+	double			r;
+	int				i;
+
+	loss_finish(app, target);
+	loss = target->loss;
+	printf("jitter = %.3f ms (RFC 3550)\n", loss->jitter / 1000);
+	printf("loss runs 1/2/3/4/5-8/9-16/17-32/33+ = ");
+	for (i = 0; i < LOSS_RUN_BUCKETS; i++)
+		printf(i ? "/%u" : "%u", loss->runs[i]);
+	printf("\n");
+	// Two state model, lossless good state and lossy bad state
+	p = 0;
+	r = 0;
+	if (loss->transitions[0][0] + loss->transitions[0][1])
+		p = (double)loss->transitions[0][1]
+			/ (loss->transitions[0][0] + loss->transitions[0][1]);
+	if (loss->transitions[1][0] + loss->transitions[1][1])
+		r = (double)loss->transitions[1][0]
+			/ (loss->transitions[1][0] + loss->transitions[1][1]);
+	printf("gilbert-elliott p = %.4f r = %.4f", p, r);
+	if (p > 0 && r > 0)
+		printf(", mean burst %.1f, mean gap %.1f, loss %.1f%%",
+			1 / r, 1 / p, 100 * p / (p + r));
+	printf("\n");
+}
@@ -0,0 +1,205 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   lowlat.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:41:52 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 18:41:52 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#define _GNU_SOURCE	// CPU_SET, sched_getcpu, sched_setaffinity
+#include "ft_ping.h"
+
+static void	lowlat_parse(t_lowlat *lowlat, const char *spec)
+{
+	char	buf[256];
+	char	*item;
+	char	*value;
+	char	*save;
+	char	*endptr;
+	long	number;
+
+	if (strlen(spec) >= sizeof(buf))
+	{
+		fprintf(stderr, "ft_ping: --low-latency settings too long\n");
+		exit(1);
+	}
+	strcpy(buf, spec);
+	for (item = strtok_r(buf, ",", &save); item;
+		item = strtok_r(NULL, ",", &save))
+	{
+		value = strchr(item, '=');
+		if (value)
+			*value++ = '\0';
+		number = value ? strtol(value, &endptr, 10) : -1;
+		if (!value || endptr == value || *endptr || number < 0)
+			number = -1;
+		if (!strcmp(item, "cpu") && number >= 0 && number < CPU_SETSIZE)
+			lowlat->cpu = number;
+		else if (!strcmp(item, "fifo") && number >= 1 && number <= 99)
+			lowlat->fifo = number;
+		else if (!strcmp(item, "busy") && number >= 0 && number <= 1000000)
+			lowlat->busy_poll = number;
+		else
+		{
+			fprintf(stderr, "ft_ping: invalid --low-latency setting '%s'\n",
+				item);
+			exit(1);
+		}
+	}
+}
+
+static void	lowlat_pin(t_lowlat *lowlat)
+{
+	cpu_set_t			set;
+	struct sched_param	param;
+
+	CPU_ZERO(&set);
+	CPU_SET(lowlat->cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	{
+		fprintf(stderr, "ft_ping: cpu %d: %s\n", lowlat->cpu, strerror(errno));
+		exit(1);
+	}
+	if (!lowlat->fifo)
+		return ;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = lowlat->fifo;
+	if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+	{
+		fprintf(stderr, "ft_ping: SCHED_FIFO: %s\n", strerror(errno));
+		exit(1);
+	}
+}
+
+/* Writes every page of [start, start + len) back to itself */
+static void	lowlat_touch(void *start, size_t len)
+{
+	volatile uint8_t	*bytes;
+	size_t				i;
+
+	bytes = start;
+	for (i = 0; i < len; i += 4096)
+		bytes[i] = bytes[i];
+	if (len)
+		bytes[len - 1] = bytes[len - 1];
+}
+
+/* Lock every page, present and future, and fault in the stack and the
+buffers now rather than on the first probes */
+static void	lowlat_prefault(t_ft_ping *app)
+{
+	uint8_t	stack[LOWLAT_STACK];
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+		fprintf(stderr, "ft_ping: mlockall: %s, pages may fault\n",
+			strerror(errno));
+	memset(stack, 0, sizeof(stack));
+	lowlat_touch(stack, sizeof(stack));
+	lowlat_touch(app->sendbuffer, sizeof(app->sendbuffer));
+	lowlat_touch(app->recvbuffer, sizeof(app->recvbuffer));
+	lowlat_touch(app->arena.base, app->arena.size);
+}
+
+/**
+ * --low-latency[=cpu=N,fifo=PRIO,busy=USEC]: the probe loop stays on one
+ * CPU (the current one by default), optionally as SCHED_FIFO, with all
+ * memory locked and touched; the socket busy polls the device queue for
+ * USEC (default LOWLAT_BUSY_POLL) and ping_wait spins instead of sleeping.
+ * Called once every buffer exists, right before the loop.
+ */
+void	lowlat_init(t_ft_ping *app)
+{
+	t_lowlat	lowlat;
+
+	lowlat.cpu = sched_getcpu();
+	lowlat.fifo = 0;
+	lowlat.busy_poll = LOWLAT_BUSY_POLL;
+	lowlat_parse(&lowlat, app->low_latency ? app->low_latency : "");
+	lowlat_pin(&lowlat);
+	lowlat_prefault(app);
+	if (app->transport.fd >= 0 && lowlat.busy_poll
+		&& setsockopt(app->transport.fd, SOL_SOCKET, SO_BUSY_POLL,
+			&lowlat.busy_poll, sizeof(lowlat.busy_poll)) < 0)
+		fprintf(stderr, "ft_ping: SO_BUSY_POLL: %s\n", strerror(errno));
+	app->options[OVERHEAD] = 1;
+}
+
+/* select() without sleeping: polls until something is ready or `timeout`
+has passed. Same return values as select */
+int	lowlat_spin(int maxfd, fd_set *fdset, struct timeval *timeout)
+{
+	struct timespec	now;
+	struct timeval	zero;
+	fd_set			polled;
+	uint64_t		deadline;
+	int				ready;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	deadline = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000
+		+ timeval_usec(*timeout);
+	while (1)
+	{
+		polled = *fdset;
+		timerclear(&zero);
+		ready = select(maxfd + 1, &polled, NULL, NULL, &zero);
+		if (ready != 0)
+			break ;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 >= deadline)
+			break ;
+	}
+	*fdset = polled;
+	return (ready);
+}
+
+static void	overhead_add(t_overhead_stat *stat, long long usec)
+{
+	stat->count++;
+	stat->sum += usec;
+	if (usec > stat->max)
+		stat->max = usec;
+}
+
+/* Kernel receive stamp to the reply in our hands: wakeup and syscall */
+void	overhead_rx(t_ft_ping *app)
+{
+	struct timeval	now;
+
+	gettimeofday(&now, NULL);
+	overhead_add(&app->overhead[0], elapsed_time(app->end, now));
+}
+
+/* Send timestamp to sendto() returning */
+void	overhead_tx(t_ft_ping *app, struct timeval sent)
+{
+	struct timeval	now;
+
+	gettimeofday(&now, NULL);
+	overhead_add(&app->overhead[1], elapsed_time(sent, now));
+}
+
+/*
+Example:
+self overhead rx avg/max = 0.004/0.031 ms, tx avg/max = 0.002/0.012 ms
+*/
+void	overhead_report(t_ft_ping *app)
+{
+	t_overhead_stat	*rx;
+	t_overhead_stat	*tx;
+
+	rx = &app->overhead[0];
+	tx = &app->overhead[1];
+	if (!tx->count)
+		return ;
+	printf("self overhead rx avg/max = %.3f/%.3f ms, "
+		"tx avg/max = %.3f/%.3f ms\n",
+		rx->count ? (double)rx->sum / rx->count / 1000 : 0.0,
+		rx->max / 1000.0,
+		tx->count ? (double)tx->sum / tx->count / 1000 : 0.0,
+		tx->max / 1000.0);
+}
@@ -12,19 +12,51 @@
 
 #include "ft_ping.h"
 
+/* --hdrincl header: --dscp, DF for --df and --pmtu (probes must not be
+fragmented), --ttl or the usual 64, IDs from --ip-id or our pid */
+static t_ip_template	*ip_template_new(t_ft_ping *app)
+{
+	t_ip_template	*tmpl;
+
+	tmpl = malloc(sizeof(*tmpl));
+	if (!tmpl)
+	{
+		perror("ft_ping: hdrincl");
+		exit(1);
+	}
+	ip_template_init(tmpl, app->options[DSCP] << 2,
+		app->options[DONT_FRAGMENT] || app->pmtu,
+		app->options[TTL] ? app->options[TTL] : IPDEFTTL,
+		app->options[IPID] ? app->options[IPID] : app->pid);
+	tmpl->dump = app->options[VERBOSE];
+	return (tmpl);
+}
+
 void	init_socket(t_ft_ping *app)
 {
 	int				raw_socket;
 
-	raw_socket = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
-	if (raw_socket < 0)
+	if (app->simulate)
+		simnet_init(&app->transport, app->simulate,
+			app->options[VIRTUAL_CLOCK]);
+	else
 	{
-		perror("ft_ping");
-		fprintf(stderr, "Lacking privilege for icmp socket.\n");
-		exit (1);
+		raw_socket = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+		if (raw_socket < 0)
+		{
+			perror("ft_ping");
+			fprintf(stderr, "Lacking privilege for icmp socket.\n");
+			exit (1);
+		}
+		set_socket_options(raw_socket);
+		if (app->options[HDRINCL])
+			transport_hdrincl_init(&app->transport, raw_socket,
+				ip_template_new(app));
+		else
+			transport_raw_init(&app->transport, raw_socket);
 	}
-	set_socket_options(raw_socket);
-	app->socket = raw_socket;
+	if (app->pcap_path)
+		pcap_attach(&app->transport, app->pcap_path, app->options[TTL]);
 }
 
 int	set_socket_options(int raw_socket)
@@ -51,34 +83,64 @@ int	set_socket_options(int raw_socket)
 			fprintf(stderr, "ft_ping: setsockopt (IP_TTL): %s\n",
 				strerror(errno));
 	}
+	if (g_ft_ping->options[HDRINCL] && setsockopt(raw_socket, IPPROTO_IP,
+			IP_HDRINCL, &enable, sizeof(enable)) != 0)
+	{
+		fprintf(stderr, "ft_ping: setsockopt (IP_HDRINCL): %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	if (g_ft_ping->pmtu)
+		pmtu_set_socket_options(raw_socket);
+	if (g_ft_ping->sweep)
+		sweep_set_socket_options(raw_socket);
 	return (0);
 }
 
-int	resolv_hostname(t_ft_ping *app)
+/* Thread safe: also called by the resolver workers */
+int	resolv_hostname(const char *hostname, struct sockaddr_in *dest_addr)
 {
 	int					status;
 	struct addrinfo		hints;
-	struct sockaddr_in	*dest_addr;
+	struct addrinfo		*res;	// Linked list of addrinfo structs from getaddrinfo
 
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_INET;
 	hints.ai_socktype = SOCK_RAW;
 	hints.ai_protocol = IPPROTO_ICMP;
-	status = getaddrinfo(app->hostname, NULL, &hints, &app->res);
+	status = getaddrinfo(hostname, NULL, &hints, &res);
 	if (status != 0)
 		return (status);
-	dest_addr = (struct sockaddr_in *)app->res->ai_addr;
-	inet_ntop(app->res->ai_family, &(dest_addr->sin_addr), app->ip_str,
-			sizeof(app->ip_str));
-	app->dest_addr = *(struct sockaddr_in *)app->res->ai_addr;
+	*dest_addr = *(struct sockaddr_in *)res->ai_addr;
+	freeaddrinfo(res);
 	return (status);
 }
 
+/**
+ * A single HOST is resolved right away, exiting when it is unknown, then
+ * refreshed in the background unless it is a literal address.
+ * Several HOSTs are resolved concurrently while the probe loop already runs.
+ */
 void	setup_destination(t_ft_ping *app)
 {
-	int	status;
-	
-	status = resolv_hostname(app);
+	int				status;
+	t_target		*target;
+	struct in_addr	literal;
+
+	if (app->target_count > 1)
+	{
+		resolver_start(app);
+		return ;
+	}
+	target = &app->targets[0];
+	if (app->sweep)
+	{
+		target_set_address(target,
+			(struct in_addr){.s_addr = htonl(app->sweep->base)});
+		target->state = TARGET_READY;
+		return ;
+	}
+	status = resolv_hostname(target->info->hostname, &target->dest_addr);
 	if (status != 0)
 	{
 		// inetutils prints "ping: unknown host" in every case
@@ -90,74 +152,75 @@ void	setup_destination(t_ft_ping *app)
 			fprintf(stderr, "ft_ping: %s\n", gai_strerror(status));
 		exit (1);
 	}
+	target_set_address(target, target->dest_addr.sin_addr);
+	target->state = TARGET_READY;
+	if (!inet_aton(target->info->hostname, &literal))
+		resolver_watch(app);
+}
+
+int	send_packet(t_transport *transport, uint8_t *sendbuffer, size_t len,
+		struct sockaddr_in *addr)
+{
+	return (send_packet_ttl(transport, sendbuffer, len, addr, 0));
 }
 
-int	send_packet(int sock, uint8_t *sendbuffer, struct sockaddr_in *addr)
+/* A TTL for this packet only (0 keeps the socket wide --ttl) */
+int	send_packet_ttl(t_transport *transport, uint8_t *sendbuffer, size_t len,
+		struct sockaddr_in *addr, int ttl)
 {
 	int	bytes;
 
-	bytes = sendto(sock, sendbuffer, g_ft_ping->packet_size, 
-			0, (struct sockaddr *)addr, sizeof(*addr));
+	bytes = transport->send(transport, sendbuffer, len, addr, ttl);
 	if (bytes < 0)
 		perror("ft_ping: sending packet");
 	return (bytes);
 }
 
-int	receive_packet(int sock, uint8_t *recvbuffer, size_t bufsize,
+int	receive_packet(t_transport *transport, uint8_t *recvbuffer, size_t bufsize,
 		struct sockaddr_in *reply_addr,	struct timeval *kernel_time)
 {
-	int				bytes;
-	struct msghdr	msg;
-	struct iovec	iov;
-	char			control[1024];
-	struct cmsghdr	*cmsg;
-
-	memset(reply_addr, 0, sizeof(*reply_addr));
-	memset(&msg, 0, sizeof(msg));
-	memset(control, 0, sizeof(control));
-	iov.iov_base = recvbuffer;
-	iov.iov_len = bufsize;
-	msg.msg_name = reply_addr;
-	msg.msg_namelen = sizeof(*reply_addr);
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	msg.msg_control = control;
-	msg.msg_controllen = sizeof(control);
-	bytes = recvmsg(sock, &msg, 0);
-	if (bytes >= 0 && kernel_time)
-	{
-		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
-		{
-			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
-				*kernel_time = *(struct timeval *)CMSG_DATA(cmsg);
-		}
-	}
-	return (bytes);
+	return (transport->recv(transport, recvbuffer, bufsize, reply_addr,
+			kernel_time));
 }
 
-void	process_packet(int bytes, t_ft_ping *app, int rcv_seq)
+/* pkt comes from packet_parse: every consumer reads the same descriptor */
+void	process_packet(t_ft_ping *app, const t_packet *pkt)
 {
-	int				offset;
-	t_ip_header		*ip_header;
-	t_icmp_header	*icmp_header;
+	t_target	*target;
 
-	if (!ip_is_valid(app->recvbuffer, bytes))
+	if (!pkt->checksum_ok)
+		fprintf(stderr, "checksum mismatch from %s\n",
+			ip_get_source_addr(pkt->ip));
+	if (app->trace)
+	{
+		trace_process(app, pkt);
+		return ;
+	}
+	if (app->pmtu)
+	{
+		pmtu_process(app, pkt);
 		return ;
-	ip_header = (t_ip_header *) app->recvbuffer;
-	offset = ip_header->ihl << 2;
-	icmp_header = (struct icmphdr *)(app->recvbuffer + offset);
-	if (!verify_checksum((uint16_t *)icmp_header, bytes - offset))
-		fprintf(stderr, "checksum mismatch from %s\n", inet_ntoa(*(struct in_addr *)&ip_header->saddr));
-	switch (icmp_header->type)
+	}
+	if (app->sweep)
+	{
+		sweep_process(app, pkt);
+		return ;
+	}
+	switch (pkt->type)
 	{
 		case ICMP_ECHOREPLY:
-			if (ntohs(icmp_header->un.echo.id) == app->pid)
-				ping_success(ip_header, app, rcv_seq);
+			target = target_lookup(app, pkt->id, pkt->ip->saddr);
+			if (target && pkt->seq <= target->sequence)
+				ping_success(app, target, pkt);
 			break ;
 		case ICMP_ECHO:
 			break ; // Ignore our own packet
 		default:
-			print_icmp_error(ip_header, icmp_header, bytes, app);
+			target = target_from_error(app, pkt);
+			USDT4(icmp_error, pkt->type, pkt->code,
+				target ? target->id : 0, pkt->seq);
+			if (target && pkt->seq <= target->sequence)
+				print_icmp_error(pkt, app);
 			break ;		
 	}
 }
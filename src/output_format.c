@@ -12,53 +12,58 @@
 
 #include "ft_ping.h"
 
-void	print_start_message(t_ft_ping *app)
+void	print_start_message(t_ft_ping *app, t_target *target)
 {
 	printf("PING %s (%s): %ld data bytes",
-		app->hostname,
-		app->ip_str,
+		target->info->hostname,
+		target->info->ip_str,
 		app->packet_size - ICMP_HEADER_SIZE
 		);
 	if (app->options[VERBOSE])
-		printf(", id 0x%04x = %d", app->pid, app->pid);
+		printf(", id 0x%04x = %d", target->id, target->id);
 	printf("\n");
 }
 
-void	print_echo(int psize, t_ip_header *ip_header, int rcv_seq,
+void	print_echo(int psize, const t_ip_header *ip_header, int rcv_seq,
 	long long time, int dup)
 {
 	if (g_ft_ping->options[QUIET])
 		return ;
 	/* 64 bytes from 127.0.0.1: icmp_seq=0 ttl=64 time=0.022 ms */
-	printf("%d bytes from %s: icmp_seq=%d ttl=%d time=%lld.%03lld ms",
+	printf("%d bytes from %s: icmp_seq=%d ttl=%d",
 		psize, ip_get_source_addr(ip_header),
-		rcv_seq,
-		ip_header->ttl, time / 1000, time % 1000);
+		rcv_seq, ip_header->ttl);
+	// time < 0: no send time to measure from
+	if (time >= 0)
+		printf(" time=%lld.%03lld ms", time / 1000, time % 1000);
 	if (dup)
 		printf(" (DUP!)");
 	printf("\n");
 }
 
+/* Example: wrong data byte #17 should be 0x42 but was 0x43 */
+void	print_wrong_byte(t_ft_ping *app, const t_packet *pkt, int offset)
+{
+	if (app->options[QUIET])
+		return ;
+	printf("wrong data byte #%d should be 0x%x but was 0x%x\n", offset,
+		app->fill[offset], pkt->payload[offset]);
+}
+
 /* 
 Handle ICMP error messages
 Example: 56 bytes from 192.168.1.1: icmp_seq=3 Destination Host Unreachable
 */
-void	print_icmp_error(t_ip_header *ip_header, t_icmp_header *icmp_header, 
-		int bytes, t_ft_ping *app)
+void	print_icmp_error(const t_packet *pkt, t_ft_ping *app)
 {
-	int	hlen, datalen, embedded_len;
-
 	if (app->options[QUIET])
 		return ;
-	hlen = ip_header->ihl << 2;
-	datalen = bytes - hlen;
 	// Bytes are the ICMP packet size, not the full IP packet size
-	printf("%d bytes from %s: ", datalen,
-			ip_get_source_addr(ip_header));
-	switch (icmp_header->type)
+	printf("%d bytes from %s: ", pkt->len, ip_get_source_addr(pkt->ip));
+	switch (pkt->type)
 	{
 		case ICMP_DEST_UNREACH:
-			switch (icmp_header->code)
+			switch (pkt->code)
 			{
 				case (ICMP_HOST_UNREACH):
 					printf("Destination Host Unreachable\n");
@@ -99,7 +104,7 @@ void	print_icmp_error(t_ip_header *ip_header, t_icmp_header *icmp_header,
 			}
 			break;
 		case (ICMP_REDIRECT):
-			switch (icmp_header->code)
+			switch (pkt->code)
 			{
 				case (ICMP_REDIR_NET):
 					printf("Redirect Network\n");
@@ -119,7 +124,7 @@ void	print_icmp_error(t_ip_header *ip_header, t_icmp_header *icmp_header,
 			}
 			break;
 		case (ICMP_TIME_EXCEEDED):
-			switch (icmp_header->code)
+			switch (pkt->code)
 			{
 				case (ICMP_EXC_TTL):
 					printf("Time to live exceeded\n");
@@ -133,41 +138,114 @@ void	print_icmp_error(t_ip_header *ip_header, t_icmp_header *icmp_header,
 			}
 			break;
 		default:
-			fprintf(stderr, "Unknown Code: %d\n", icmp_header->code);
+			fprintf(stderr, "Unknown Code: %d\n", pkt->code);
 			break;
 	}
-	if (app->options[VERBOSE])
-	{
-		embedded_len = bytes;
-		// Since it's an error, dump the embedded ip message
-		packet_dump(extract_embedded_packet((uint8_t *)ip_header, &embedded_len), embedded_len);
-	}
+	// Since it's an error, dump the embedded ip message
+	if (app->options[VERBOSE] && pkt->payload_len >= (int)sizeof(t_ip_header))
+		packet_dump(pkt->payload, pkt->payload_len);
 }
 
-void	print_exit_message(t_ft_ping *app)
+/* Example: flood window 32, 41234 replies/s */
+static void	print_flood_rate(t_ft_ping *app, t_target *target)
+{
+	struct timeval	now;
+	long long		elapsed;
+
+	clock_now(&now);
+	elapsed = elapsed_time(app->start, now);
+	if (elapsed <= 0)
+		return ;
+	printf("flood window %d, %.0f replies/s\n", app->options[WINDOW],
+		target->rcv_packets * 1e6 / elapsed);
+}
+
+static void	print_target_stats(t_ft_ping *app, t_target *target)
 {
 	float		loss;
 	
-	if (!app || app->rcv_packets < 1)
+	if (target->rcv_packets < 1)
 		return ;
 	loss = 0.0;
-	if (g_ft_ping->sent_packets > 0)
-	loss = 100 - (g_ft_ping->rcv_packets * 100 / g_ft_ping->sent_packets);
+	if (target->sent_packets > 0)
+	loss = 100 - (target->rcv_packets * 100 / target->sent_packets);
 	/* Example:	
 	--- 1.1.1.1 ping statistics ---
 	1 packets transmitted, 1 packets received, 0% packet loss */
-	printf("--- %s ping statistics ---\n", g_ft_ping->hostname);
-	printf("%d packets transmitted, %d packets received, ", g_ft_ping->sent_packets, g_ft_ping->rcv_packets);
-	if (app->dup_packets)
-		printf("+%d duplicates, ", app->dup_packets);
+	printf("--- %s ping statistics ---\n", target->info->hostname);
+	printf("%d packets transmitted, %d packets received, ", target->sent_packets, target->rcv_packets);
+	if (target->dup_packets)
+		printf("+%d duplicates, ", target->dup_packets);
+	if (target->late_packets)
+		printf("%d late, ", target->late_packets);
 	printf("%.1f%% packet loss\n", loss);
+	if (target->bad_stamps)
+		printf("%d replies echoed a wrong timestamp\n", target->bad_stamps);
+	if (target->corrupted)
+		printf("%d replies with wrong data\n", target->corrupted);
 	/* Example: 
 	round-trip min/avg/max/stddev = 31.634/31.634/31.634/0.000 ms */
-	printf("round-trip min/avg/max/stddev = %lld.%lld/%lld.%lld/%lld.%lld/%lld.%lld ms\n",
-	app->stats[MIN] / 1000, app->stats[MIN] % 1000,
-	app->stats[AVG] / 1000, app->stats[AVG] % 1000,
-	app->stats[MAX] / 1000, app->stats[MAX] % 1000,
-	app->stats[STDDEV] / 1000, app->stats[STDDEV] % 1000);
+	printf("round-trip min/avg/max/stddev = %lld.%03lld/%lld.%03lld/%lld.%03lld/%lld.%03lld ms\n",
+	target->stats[MIN] / 1000, target->stats[MIN] % 1000,
+	target->stats[AVG] / 1000, target->stats[AVG] % 1000,
+	target->stats[MAX] / 1000, target->stats[MAX] % 1000,
+	target->stats[STDDEV] / 1000, target->stats[STDDEV] % 1000);
+	if (app->options[WINDOW])
+		print_flood_rate(app, target);
+	if (app->options[PERCENTILES])
+		sketch_print(target->sketch);
+	if (app->options[JITTER])
+		loss_report(app, target);
+}
+
+/* Percentiles over the replies of every target, from merged sketches */
+static void	print_fleet_percentiles(t_ft_ping *app)
+{
+	t_sketch	*all;
+	size_t		i;
+
+	all = calloc(1, sizeof(*all));
+	if (!all)
+		return ;
+	for (i = 0; i < app->target_count; i++)
+		sketch_merge(all, app->targets[i].sketch);
+	printf("--- %zu hosts ---\n", app->target_count);
+	sketch_print(all);
+	free(all);
+}
+
+/* One statistics block per target, in command line order */
+void	print_exit_message(t_ft_ping *app)
+{
+	size_t	i;
+
+	if (!app)
+		return ;
+	if (app->sketch_path)
+		sketch_save_targets(app);
+	if (app->series)
+		series_dump(app);
+	if (app->trace)
+	{
+		trace_report(app);
+		return ;
+	}
+	if (app->pmtu)
+	{
+		pmtu_report(app);
+		return ;
+	}
+	if (app->sweep)
+	{
+		sweep_report(app);
+		return ;
+	}
+	for (i = 0; i < app->target_count; i++)
+		print_target_stats(app, &app->targets[i]);
+	if (app->options[OVERHEAD])
+		overhead_report(app);
+	if (app->options[PERCENTILES] && app->target_count > 1)
+		print_fleet_percentiles(app);
 }
 
 /*
@@ -179,13 +257,23 @@ Vr HL TOS  Len   ID Flg  off TTL Pro  cks      Src      Dst     Data
  4  5  00 0054 257f   2 0000  40  01 fdfa 10.0.1.50  10.0.1.254 
 ICMP: type 8, code 0, size 64, id 0x8a0e, seq 0x0000
 */
-void	packet_dump(uint8_t *bytes, size_t len)
+void	packet_dump(const uint8_t *bytes, size_t len)
+{
+	const t_ip_header	*ip;
+
+	ip = (const t_ip_header *)bytes;
+	datagram_dump(ip, len, bytes + (ip->ihl << 2));
+}
+
+/* packet_dump of a datagram whose header (len bytes of it readable) and
+ICMP message, at data, lie apart */
+void	datagram_dump(const t_ip_header *ip, size_t len, const uint8_t *data)
 {
-	t_ip_header	*ip;
+	const uint8_t	*bytes;
 	size_t		ip_len, header_len;
 	char		source_addr[INET_ADDRSTRLEN], dest_addr[INET_ADDRSTRLEN];
 
-	ip = (t_ip_header *)bytes;
+	bytes = (const uint8_t *)ip;
 	header_len = ip->ihl << 2;
 	ip_len = ntohs(ip->tot_len);
 	printf("IP Hdr Dump:\n ");
@@ -200,18 +288,14 @@ void	packet_dump(uint8_t *bytes, size_t len)
 	printf("%04x   %01x %04x  ", ntohs(ip->id), (frag_off >> 13) & 0x7, frag_off & 0x1fff);
 	printf("%02x  %02x %04x ", ip->ttl, ip->protocol, ntohs(ip->check));
 	printf("%s  %s\n", source_addr, dest_addr);
-	bytes += header_len; // point to options
-	if (header_len > sizeof(*ip))
-	{
-		while (header_len-- > sizeof(*ip))
-			printf("%02x", *bytes++);
-	}
+	for (size_t i = sizeof(*ip); i < len && i < header_len; i++)
+		printf("%02x", bytes[i]); // options
 	if (ip->protocol != 1) // Supporting only ICMP for the moment
 	{
 		fprintf(stderr, "unsupported protocol: %d\n", ip->protocol);
 		return ;
 	}
-	t_icmp_header *icmp = (t_icmp_header *)bytes;
+	const t_icmp_header *icmp = (const t_icmp_header *)data;
 	printf("ICMP: ");
 	printf("type %d, code %d, size %ld", 
 		icmp->type, icmp->code, ip_len - header_len);
@@ -239,10 +323,47 @@ void	print_help(char *prog_name)
 	printf("  %-4s %-20s %s\n", "", "--ttl=N", "specify N as time-to-live");
 	printf("  %-4s %-20s %s\n", "-v,", "--verbose", "verbose output");
 	printf("  %-4s %-20s %s\n", "-w,", "--timeout=N", "stop after N seconds");
+	printf("  %-4s %-20s %s\n", "-W,", "--linger=N", "number of seconds to wait for each response,");
+	printf("  %-4s %-20s %s\n", "", "", "later replies are timeouts");
+	printf("  %-4s %-20s %s\n", "", "--dns-ttl=N", "re-resolve each HOST every N seconds (default 300)");
+	printf("  %-4s %-20s %s\n", "", "--resolvers=N", "resolve several HOSTs with N threads (default 16)");
+	printf("  %-4s %-20s %s\n", "", "--rdns", "show reply sources by name (looked up in background)");
+	printf("  %-4s %-20s %s\n", "", "--trace", "map the path, probing every TTL at once each round");
+	printf("  %-4s %-20s %s\n", "", "--max-hops=N", "probe TTLs up to N in --trace mode (default 30)");
+	printf("  %-4s %-20s %s\n", "", "--pmtu", "discover the path MTU, probing many sizes at once");
+	printf("  %-4s %-20s %s\n", "", "--rate=PPS", "probes per second when HOST is a range a.b.c.d/nn");
+	printf("  %-4s %-20s %s\n", "", "", "(default 1000)");
+	printf("  %-4s %-20s %s\n", "", "--simulate[=SPEC]", "answer from an in-memory network, SPEC as in");
+	printf("  %-4s %-20s %s\n", "", "", "delay=MS,jitter=MS,loss=%,dup=%,reorder=%,");
+	printf("  %-4s %-20s %s\n", "", "", "corrupt=%,seed=N");
+	printf("  %-4s %-20s %s\n", "", "--virtual-clock", "run --simulate in simulated time, jumping to");
+	printf("  %-4s %-20s %s\n", "", "", "the next event instead of waiting for it");
+	printf("  %-4s %-20s %s\n", "", "--pcap=FILE", "record requests and replies to a pcap FILE");
+	printf("  %-4s %-20s %s\n", "", "--replay=FILE", "replay the echo session captured in a pcap FILE");
+	printf("  %-4s %-20s %s\n", "", "--percentiles", "print RTT percentiles (p50/p90/p99/p99.9)");
+	printf("  %-4s %-20s %s\n", "", "--save-sketch=FILE", "save each host's RTT sketch to FILE at exit");
+	printf("  %-4s %-20s %s\n", "", "--merge-sketch", "merge the sketch FILEs given instead of HOSTs");
+	printf("  %-4s %-20s %s\n", "", "--jitter", "print RFC 3550 jitter and loss bursts");
+	printf("  %-4s %-20s %s\n", "", "--series=FILE", "write per second, minute and hour stats to FILE");
+	printf("  %-4s %-20s %s\n", "", "", "at exit and on SIGUSR1");
+	printf("  %-4s %-20s %s\n", "", "--check-stamp", "count replies whose echoed timestamp differs");
+	printf("  %-4s %-20s %s\n", "", "", "from the send time");
+	printf("  %-4s %-20s %s\n", "", "--low-latency[=SPEC]", "pin to a CPU, lock memory, busy poll and spin,");
+	printf("  %-4s %-20s %s\n", "", "", "SPEC as in cpu=N,fifo=PRIO,busy=USEC");
+	printf("  %-4s %-20s %s\n", "", "--overhead", "report the time ft_ping adds to each send and");
+	printf("  %-4s %-20s %s\n", "", "", "receive");
+	printf("  %-4s %-20s %s\n", "", "--hdrincl", "build the IP header ourselves (IP_HDRINCL),");
+	printf("  %-4s %-20s %s\n", "", "", "dumped for each probe with -v");
+	printf("  %-4s %-20s %s\n", "", "--dscp=N", "set the DSCP of each probe to N (implies --hdrincl)");
+	printf("  %-4s %-20s %s\n", "", "--df", "set Don't Fragment (implies --hdrincl)");
+	printf("  %-4s %-20s %s\n", "", "--ip-id=N", "number IP IDs from N (implies --hdrincl)");
 	printf("\n");
 	printf(" Options valid for --echo requests:\n\n");
 	printf("  %-4s %-20s %s\n", "-f,", "--flood", "flood ping (root only)");
+	printf("  %-4s %-20s %s\n", "", "--window=N", "keep N probes in flight with -f (default 1)");
+	printf("  %-4s %-20s %s\n", "-p,", "--pattern=PATTERN", "fill ICMP packet with given pattern (hex)");
 	printf("  %-4s %-20s %s\n", "-q,", "--quiet", "quiet output");
+	printf("  %-4s %-20s %s\n", "-s,", "--size=NUMBER", "send NUMBER data octets");
 	printf("\n");
 	printf("  %-4s %-20s %s\n", "-?,", "--help", "give this help list");
 	printf("  %-4s %-20s %s\n", "", "--usage", "give a short usage message");
@@ -251,7 +372,9 @@ void	print_help(char *prog_name)
 
 void	print_usage(char *prog_name)
 {
-	printf("Usage: sudo %s [-vfq?V] [-c NUMBER] [-i NUMBER] [-w N] [--ttl=N] [-l NUMBER] ", prog_name);
+	printf("Usage: sudo %s [-vfq?V] [-c NUMBER] [-i NUMBER] [-w N] [-W N] [--ttl=N] [-l NUMBER] ", prog_name);
+	printf("[--dns-ttl=N] [--resolvers=N] [--rdns] [--trace] [--max-hops=N] ");
+	printf("[--pmtu] [--rate=PPS] [--simulate[=SPEC]] [--virtual-clock] [--pcap=FILE] [--replay=FILE] [--percentiles] [--save-sketch=FILE] [--merge-sketch] [--jitter] [--series=FILE] [--check-stamp] [--low-latency[=SPEC]] [--overhead] [--hdrincl] [--dscp=N] [--df] [--ip-id=N] [-p PATTERN] [--window=N] [-s NUMBER] ");
 	printf("HOST ...\n");
 }
 
@@ -40,10 +40,11 @@ static uint16_t	parse_uint16(char *optarg, char *prog_name, char *opt_name,
 }
 
 /*
- * Parse floating point interval with range validation
+ * Parse floating point seconds with range validation (up to 65.535)
  * Converts to milliseconds for uint16_t storage
  */
-static uint16_t	parse_interval(char *optarg, char *prog_name)
+static uint16_t	parse_seconds(char *optarg, char *prog_name, char *opt_name,
+				double min)
 {
 	char	*endptr;
 	double	value;
@@ -52,19 +53,138 @@ static uint16_t	parse_interval(char *optarg, char *prog_name)
 	value = strtod(optarg, &endptr);
 	if (errno == ERANGE || *endptr != '\0' || endptr == optarg)
 	{
-		fprintf(stderr, "%s: invalid interval value: %s\n",
-			prog_name, optarg);
+		fprintf(stderr, "%s: invalid %s value: %s\n",
+			prog_name, opt_name, optarg);
 		exit(1);
 	}
-	if (value < 0.2 || value > 65.535)
+	if (value < min || value > 65.535)
 	{
-		fprintf(stderr, "%s: interval must be between 0.2 and 65.535 seconds\n",
-			prog_name);
+		fprintf(stderr, "%s: %s must be between %g and 65.535 seconds\n",
+			prog_name, opt_name, min);
 		exit(1);
 	}
 	return ((uint16_t)round(value * 1000.0));
 }
 
+/*
+ * -p: up to PATTERN_MAX bytes in hex, two digits each ("ff0a" is ff 0a,
+ * a lone last digit is a byte of its own)
+ */
+static void	parse_pattern(char *optarg, char *prog_name, t_ft_ping *app)
+{
+	char	digits[3];
+	char	*p;
+
+	app->pattern_len = 0;
+	for (p = optarg; *p; p += digits[1] ? 2 : 1)
+	{
+		digits[0] = p[0];
+		digits[1] = p[1];
+		digits[2] = '\0';
+		if (!isxdigit((unsigned char)p[0])
+			|| (p[1] && !isxdigit((unsigned char)p[1]))
+			|| app->pattern_len == PATTERN_MAX)
+		{
+			fprintf(stderr, "%s: error in pattern near %s\n", prog_name, p);
+			exit(1);
+		}
+		app->pattern[app->pattern_len++] = strtol(digits, NULL, 16);
+	}
+	if (!app->pattern_len)
+	{
+		fprintf(stderr, "%s: empty pattern\n", prog_name);
+		exit(1);
+	}
+}
+
+/* A CIDR range is swept alone, any other HOST is pinged as usual */
+static void	check_sweep(t_ft_ping *app, char *prog_name)
+{
+	size_t	i;
+
+	for (i = 0; i < app->target_count; i++)
+	{
+		if (!sweep_is_range(app->hostnames[i]))
+			continue ;
+		if (app->target_count > 1)
+		{
+			fprintf(stderr, "%s: a range %s must be the only HOST\n",
+				prog_name, app->hostnames[i]);
+			exit(1);
+		}
+		if (app->options[TRACE] || app->options[PMTU])
+		{
+			fprintf(stderr, "%s: --%s does not take a range\n", prog_name,
+				app->options[TRACE] ? "trace" : "pmtu");
+			exit(1);
+		}
+	}
+}
+
+static void	parse_defaults(t_ft_ping *app)
+{
+	if (!app->options[INTERVAL])
+		app->options[INTERVAL] = INTERVAL_MS;
+	if (!app->options[DNS_TTL])
+		app->options[DNS_TTL] = DNS_TTL_DEFAULT;
+	if (!app->options[RESOLVERS])
+		app->options[RESOLVERS] = RESOLVER_THREADS;
+	if (!app->options[RATE])
+		app->options[RATE] = SWEEP_RATE_DEFAULT;
+	if (!app->options[MAX_HOPS])
+		app->options[MAX_HOPS] = TRACE_DEFAULT_HOPS;
+	// -f alone keeps one probe in flight, like iputils
+	if (app->options[FLOOD] && !app->options[WINDOW] && !app->options[REPLAY])
+		app->options[WINDOW] = 1;
+}
+
+/* Virtual time only makes sense where nothing real answers, and spinning
+or measuring our own overhead needs the real one */
+static void	check_virtual_clock(t_ft_ping *app, char *prog_name)
+{
+	if (!app->options[VIRTUAL_CLOCK])
+		return ;
+	if (!app->options[SIMULATE])
+	{
+		fprintf(stderr, "%s: --virtual-clock needs --simulate\n", prog_name);
+		exit(1);
+	}
+	if (app->options[LOW_LATENCY] || app->options[OVERHEAD])
+	{
+		fprintf(stderr, "%s: --virtual-clock and --%s incompatible options\n",
+			prog_name, app->options[LOW_LATENCY] ? "low-latency" : "overhead");
+		exit(1);
+	}
+}
+
+/* A capture is replayed on its own: its HOSTs come from the file */
+static void	check_replay(t_ft_ping *app, int hosts, char *prog_name)
+{
+	if (hosts > 0)
+	{
+		fprintf(stderr, "%s: --replay takes no HOST\n", prog_name);
+		exit(1);
+	}
+	if (app->options[TRACE] || app->options[PMTU] || app->options[SIMULATE]
+		|| app->options[PCAP] || app->options[HDRINCL])
+	{
+		fprintf(stderr, "%s: --replay only works with ping options\n",
+			prog_name);
+		exit(1);
+	}
+	if (app->options[WINDOW])
+	{
+		fprintf(stderr, "%s: --window needs a live run\n", prog_name);
+		exit(1);
+	}
+	// Send times are capture times there, never the stamp written
+	if (app->options[CHECK_STAMP])
+	{
+		fprintf(stderr, "%s: --check-stamp needs a live run\n", prog_name);
+		exit(1);
+	}
+}
+
 static struct option s_long_options[] = 
 {
 	{"count", 		required_argument,	0, 'c'},
@@ -75,6 +195,33 @@ static struct option s_long_options[] =
 	{"flood",		no_argument,		0, 'f'},
 	{"preload",		required_argument,	0, 'l'},
 	{"quiet", 		no_argument,		0, 'q'},
+	{"size",		required_argument,	0, 's'},
+	{"dns-ttl",		required_argument,	0, DNS_TTL + ONLY_LONG},
+	{"resolvers",	required_argument,	0, RESOLVERS + ONLY_LONG},
+	{"rdns",		no_argument,		0, RDNS + ONLY_LONG},
+	{"trace",		no_argument,		0, TRACE + ONLY_LONG},
+	{"max-hops",	required_argument,	0, MAX_HOPS + ONLY_LONG},
+	{"pmtu",		no_argument,		0, PMTU + ONLY_LONG},
+	{"rate",		required_argument,	0, RATE + ONLY_LONG},
+	{"simulate",	optional_argument,	0, SIMULATE + ONLY_LONG},
+	{"pcap",		required_argument,	0, PCAP + ONLY_LONG},
+	{"replay",		required_argument,	0, REPLAY + ONLY_LONG},
+	{"percentiles",	no_argument,		0, PERCENTILES + ONLY_LONG},
+	{"save-sketch",	required_argument,	0, SAVE_SKETCH + ONLY_LONG},
+	{"merge-sketch",	no_argument,	0, MERGE_SKETCH + ONLY_LONG},
+	{"jitter",		no_argument,		0, JITTER + ONLY_LONG},
+	{"series",		required_argument,	0, SERIES + ONLY_LONG},
+	{"check-stamp",	no_argument,		0, CHECK_STAMP + ONLY_LONG},
+	{"low-latency",	optional_argument,	0, LOW_LATENCY + ONLY_LONG},
+	{"overhead",	no_argument,		0, OVERHEAD + ONLY_LONG},
+	{"pattern",		required_argument,	0, 'p'},
+	{"window",		required_argument,	0, WINDOW + ONLY_LONG},
+	{"linger",		required_argument,	0, 'W'},
+	{"virtual-clock",	no_argument,	0, VIRTUAL_CLOCK + ONLY_LONG},
+	{"hdrincl",		no_argument,		0, HDRINCL + ONLY_LONG},
+	{"dscp",		required_argument,	0, DSCP + ONLY_LONG},
+	{"df",			no_argument,		0, DONT_FRAGMENT + ONLY_LONG},
+	{"ip-id",		required_argument,	0, IPID + ONLY_LONG},
 	{"help", 		no_argument,		0, '?'},
 	{"usage",		no_argument,		0, USAGE + ONLY_LONG},
 	{0, 0, 0, 0}
@@ -82,15 +229,39 @@ static struct option s_long_options[] =
 
 /**
  * Parse command line arguments using POSIX getopt()
- * Option string "Vvc:i:qw:?":
+ * Option string "Vvc:i:l:qs:w:W:p:f?":
  *   - 'V' = version (no argument)
  *   - 'v' = verbose flag (no argument)
  *   - 'c:' = count option (requires argument)
  *   - 'i:' = interval option (requires argument)
  *   - 'l:' = preload option (requires argument)
  *   - 'q' = quiet flag (no argument)
+ *   - 's:' = size option (requires argument)
  *   - 'w:' = timeout option (requires argument)
+ *   - 'p:' = payload pattern in hex (requires argument)
+ *   - 'W:' = seconds each probe waits for its reply (requires argument)
  *   - 'ttl:' = ttl option (requires argument, long-only)
+ *   - 'dns-ttl:' = seconds before re-resolving a HOST (long-only)
+ *   - 'resolvers:' = resolver threads for several HOSTs (long-only)
+ *   - 'rdns' = print reply sources by name, looked up in the background
+ *   - 'trace' = probe every TTL up to 'max-hops:' at once (long-only)
+ *   - 'pmtu' = path MTU discovery (long-only)
+ *   - 'rate:' = probes per second when HOST is a CIDR range (long-only)
+ *   - 'simulate::' = in-memory network instead of a raw socket (long-only)
+ *   - 'pcap:' = record every packet sent and received to FILE (long-only)
+ *   - 'replay:' = run the reply pipeline over a pcap FILE (long-only)
+ *   - 'percentiles' = RTT percentiles in the summary (long-only)
+ *   - 'save-sketch:' = write the RTT sketches to FILE at exit (long-only)
+ *   - 'merge-sketch' = the arguments are saved sketches to merge (long-only)
+ *   - 'jitter' = RFC 3550 jitter and loss bursts in the summary (long-only)
+ *   - 'series:' = per second/minute/hour stats to FILE (long-only)
+ *   - 'check-stamp' = count replies echoing a wrong timestamp (long-only)
+ *   - 'low-latency::' = pinned, locked, spinning probe loop (long-only)
+ *   - 'overhead' = report our own send and receive overhead (long-only)
+ *   - 'window:' = probes in flight at once with -f (long-only)
+ *   - 'virtual-clock' = simulated time, waits return at once (long-only)
+ *   - 'hdrincl' = send prebuilt IPv4 headers with IP_HDRINCL (long-only)
+ *   - 'dscp:', 'df', 'ip-id:' = fields of that header, imply it (long-only)
  *   - '?' = help flag (no argument)
  */
 void	parse_args(int ac, char **av, t_ft_ping *app)
@@ -98,7 +269,7 @@ void	parse_args(int ac, char **av, t_ft_ping *app)
 	int	opt;
 	int	option_index;
 
-	while ((opt = getopt_long(ac, av, "Vvc:i:l:qw:f?",
+	while ((opt = getopt_long(ac, av, "Vvc:i:l:qs:w:W:p:f?",
 			s_long_options, &option_index)) != -1)
 	{
 		if (opt == 'v')
@@ -111,32 +282,113 @@ void	parse_args(int ac, char **av, t_ft_ping *app)
 		else if (opt == 'c')
 			app->options[COUNT] = parse_uint16(optarg, av[0], "count", 1, 65535);
 		else if (opt == 'i')
-			app->options[INTERVAL] = parse_interval(optarg, av[0]);
+			app->options[INTERVAL] = parse_seconds(optarg, av[0], "interval",
+				0.2);
 		else if (opt == 'l')
-		{
-			if (getuid() != 0)
-			{
-				fprintf(stderr, "%s: preload option requires root privileges\n", av[0]);
-				exit(1);
-			}
 			app->options[PRELOAD] = parse_uint16(optarg, av[0], "preload", 1, 65535);
-		}
 		else if (opt == 'f')
-		{
-			if (getuid() != 0)
-			{
-				fprintf(stderr, "%s: flood option requires root privileges\n", av[0]);
-				exit(1);
-			}
 			app->options[FLOOD] = 1;
-		}
 		else if (opt == 'q')
 			app->options[QUIET] = 1;
+		else if (opt == 's')
+		{
+			// -s 0 is valid, so the size goes straight to packet_size
+			app->options[SIZE] = 1;
+			app->packet_size = ICMP_HEADER_SIZE + parse_uint16(optarg, av[0],
+					"size", MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE);
+		}
+		else if (opt == 'W')
+			app->options[LINGER] = parse_seconds(optarg, av[0], "linger",
+				0.001);
+		else if (opt == 'p')
+		{
+			app->options[PATTERN] = 1;
+			parse_pattern(optarg, av[0], app);
+		}
 		else if (opt == 'w')
 			app->options[TIMEOUT] = parse_uint16(optarg, av[0], "timeout",
 				1, 65535);
 		else if (opt == TTL + ONLY_LONG)
 			app->options[TTL] = parse_uint16(optarg, av[0], "ttl", 1, 255);
+		else if (opt == DNS_TTL + ONLY_LONG)
+			app->options[DNS_TTL] = parse_uint16(optarg, av[0], "dns-ttl",
+				1, 65535);
+		else if (opt == RESOLVERS + ONLY_LONG)
+			app->options[RESOLVERS] = parse_uint16(optarg, av[0], "resolvers",
+				1, MAX_RESOLVER_THREADS);
+		else if (opt == RDNS + ONLY_LONG)
+			app->options[RDNS] = 1;
+		else if (opt == TRACE + ONLY_LONG)
+			app->options[TRACE] = 1;
+		else if (opt == PMTU + ONLY_LONG)
+			app->options[PMTU] = 1;
+		else if (opt == SIMULATE + ONLY_LONG)
+		{
+			app->options[SIMULATE] = 1;
+			app->simulate = optarg ? optarg : "";
+		}
+		else if (opt == PCAP + ONLY_LONG)
+		{
+			app->options[PCAP] = 1;
+			app->pcap_path = optarg;
+		}
+		else if (opt == REPLAY + ONLY_LONG)
+		{
+			app->options[REPLAY] = 1;
+			app->replay_path = optarg;
+		}
+		else if (opt == PERCENTILES + ONLY_LONG)
+			app->options[PERCENTILES] = 1;
+		else if (opt == SAVE_SKETCH + ONLY_LONG)
+		{
+			app->options[SAVE_SKETCH] = 1;
+			app->sketch_path = optarg;
+		}
+		else if (opt == MERGE_SKETCH + ONLY_LONG)
+			app->options[MERGE_SKETCH] = 1;
+		else if (opt == JITTER + ONLY_LONG)
+			app->options[JITTER] = 1;
+		else if (opt == CHECK_STAMP + ONLY_LONG)
+			app->options[CHECK_STAMP] = 1;
+		else if (opt == LOW_LATENCY + ONLY_LONG)
+		{
+			app->options[LOW_LATENCY] = 1;
+			app->low_latency = optarg;
+		}
+		else if (opt == OVERHEAD + ONLY_LONG)
+			app->options[OVERHEAD] = 1;
+		else if (opt == VIRTUAL_CLOCK + ONLY_LONG)
+			app->options[VIRTUAL_CLOCK] = 1;
+		else if (opt == HDRINCL + ONLY_LONG)
+			app->options[HDRINCL] = 1;
+		else if (opt == DSCP + ONLY_LONG)
+		{
+			app->options[HDRINCL] = 1;
+			app->options[DSCP] = parse_uint16(optarg, av[0], "dscp", 0, 63);
+		}
+		else if (opt == DONT_FRAGMENT + ONLY_LONG)
+		{
+			app->options[HDRINCL] = 1;
+			app->options[DONT_FRAGMENT] = 1;
+		}
+		else if (opt == IPID + ONLY_LONG)
+		{
+			app->options[HDRINCL] = 1;
+			app->options[IPID] = parse_uint16(optarg, av[0], "ip-id", 1, 65535);
+		}
+		else if (opt == SERIES + ONLY_LONG)
+		{
+			app->options[SERIES] = 1;
+			app->series_path = optarg;
+		}
+		else if (opt == WINDOW + ONLY_LONG)
+			app->options[WINDOW] = parse_uint16(optarg, av[0], "window",
+				1, FLOOD_WINDOW_MAX);
+		else if (opt == RATE + ONLY_LONG)
+			app->options[RATE] = parse_uint16(optarg, av[0], "rate", 1, 65535);
+		else if (opt == MAX_HOPS + ONLY_LONG)
+			app->options[MAX_HOPS] = parse_uint16(optarg, av[0], "max-hops",
+				1, TRACE_MAX_HOPS);
 		else if (opt == USAGE + ONLY_LONG)
 		{
 			print_usage(av[0]);
@@ -153,24 +405,65 @@ void	parse_args(int ac, char **av, t_ft_ping *app)
 			exit(1);
 		}
 	}
+	// Nothing leaves the process on a simulated network
+	if ((app->options[PRELOAD] || app->options[FLOOD]) && getuid() != 0
+		&& !app->options[SIMULATE])
+	{
+		fprintf(stderr, "%s: %s option requires root privileges\n", av[0],
+			app->options[FLOOD] ? "flood" : "preload");
+		exit(1);
+	}
 	if (app->options[FLOOD] && app->options[INTERVAL])
 	{
 		fprintf(stderr, "%s: -f and -i incompatible options\n", av[0]);
 		exit(1);
 	}
+	if (app->options[WINDOW] && !app->options[FLOOD])
+	{
+		fprintf(stderr, "%s: --window only applies to -f\n", av[0]);
+		exit(1);
+	}
+	check_virtual_clock(app, av[0]);
+	if (app->options[HDRINCL] && app->options[SIMULATE])
+	{
+		fprintf(stderr, "%s: --hdrincl needs a raw socket, not --simulate\n",
+			av[0]);
+		exit(1);
+	}
+	if (app->options[TRACE] && app->options[TTL])
+	{
+		fprintf(stderr, "%s: --trace and --ttl incompatible options\n", av[0]);
+		exit(1);
+	}
+	if (app->options[TRACE] && app->options[PMTU])
+	{
+		fprintf(stderr, "%s: --trace and --pmtu incompatible options\n", av[0]);
+		exit(1);
+	}
+	if ((app->options[TRACE] || app->options[PMTU]) && optind + 1 < ac)
+	{
+		fprintf(stderr, "%s: --%s takes a single HOST\n", av[0],
+			app->options[TRACE] ? "trace" : "pmtu");
+		exit(1);
+	}
+	if (app->options[REPLAY])
+	{
+		check_replay(app, ac - optind, av[0]);
+		parse_defaults(app);
+		return ;
+	}
 	if (optind < ac)
-		app->hostname = av[optind];
+	{
+		app->hostnames = av + optind;
+		app->target_count = ac - optind;
+	}
 	else
 	{
 		fprintf(stderr, "%s: missing hostname\n", av[0]);
 		print_help(av[0]);
 		exit(1);
 	}
-	if (optind + 1 < ac)
-	{
-		fprintf(stderr, "%s: extra arguments after hostname\n", av[0]);
-		exit(1);
-	}
-	if (!app->options[INTERVAL])
-		app->options[INTERVAL] = INTERVAL_MS;
+	if (!app->options[MERGE_SKETCH])
+		check_sweep(app, av[0]);
+	parse_defaults(app);
 }
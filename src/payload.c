@@ -0,0 +1,112 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   payload.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 09:16:04 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 09:16:04 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ft_ping.h"
+
+/**
+ * The payload every probe carries once its timestamp is written: the -p
+ * pattern repeated from offset 0, like inetutils, or 0x42 bytes. Built once,
+ * copied by prepare_payload and compared against by payload_check.
+ */
+void	payload_fill(t_ft_ping *app)
+{
+	size_t	i;
+
+	if (!app->pattern_len)
+	{
+		memset(app->fill, 0x42, sizeof(app->fill));
+		return ;
+	}
+	for (i = 0; i < sizeof(app->fill); i++)
+		app->fill[i] = app->pattern[i % app->pattern_len];
+}
+
+/* Offset of the first byte where a and b differ, len when they don't */
+static size_t	first_difference(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t		i;
+#ifdef __SSE2__
+	__m128i		eq;
+	unsigned	mask;
+
+	i = 0;
+	// 64 bytes per round while they match, then 16 to find the block
+	while (i + 64 <= len)
+	{
+		eq = _mm_and_si128(
+				_mm_and_si128(
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+						_mm_loadu_si128((const __m128i *)(b + i))),
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+						_mm_loadu_si128((const __m128i *)(b + i + 16)))),
+				_mm_and_si128(
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+						_mm_loadu_si128((const __m128i *)(b + i + 32))),
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+						_mm_loadu_si128((const __m128i *)(b + i + 48)))));
+		if (_mm_movemask_epi8(eq) != 0xffff)
+			break ;
+		i += 64;
+	}
+	while (i + 16 <= len)
+	{
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+					_mm_loadu_si128((const __m128i *)(a + i)),
+					_mm_loadu_si128((const __m128i *)(b + i))));
+		if (mask != 0xffff)
+			return (i + __builtin_ctz(~mask));
+		i += 16;
+	}
+#else
+	uint64_t	wa;
+	uint64_t	wb;
+
+	i = 0;
+	while (i + sizeof(wa) <= len)
+	{
+		memcpy(&wa, a + i, sizeof(wa));
+		memcpy(&wb, b + i, sizeof(wb));
+		if (wa != wb)
+			break ;
+		i += sizeof(wa);
+	}
+#endif
+	while (i < len && a[i] == b[i])
+		i++;
+	return (i);
+}
+
+/**
+ * Offset in the payload of the first byte of an echo reply that isn't what
+ * we sent, -1 when it all matches. The timestamp is left to --check-stamp
+ * and a reply shorter than the probe is only compared as far as it goes.
+ */
+int	payload_check(t_ft_ping *app, const t_packet *pkt)
+{
+	size_t	start;
+	size_t	len;
+	size_t	offset;
+
+	len = app->packet_size - ICMP_HEADER_SIZE;
+	if ((size_t)pkt->payload_len < len)
+		len = pkt->payload_len;
+	start = 0;
+	if (app->packet_size - ICMP_HEADER_SIZE >= sizeof(struct timeval))
+		start = sizeof(struct timeval);
+	if (len <= start)
+		return (-1);
+	offset = start + first_difference(pkt->payload + start, app->fill + start,
+			len - start);
+	if (offset == len)
+		return (-1);
+	return (offset);
+}
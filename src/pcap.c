@@ -0,0 +1,200 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   pcap.c                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 11:20:35 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 11:20:35 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+// Classic libpcap file format, microsecond timestamps
+typedef struct s_pcap_file_header
+{
+	uint32_t	magic;
+	uint16_t	version_major;
+	uint16_t	version_minor;
+	int32_t		thiszone;
+	uint32_t	sigfigs;
+	uint32_t	snaplen;
+	uint32_t	linktype;
+}	t_pcap_file_header;
+
+typedef struct s_pcap_record
+{
+	uint32_t	ts_sec;
+	uint32_t	ts_usec;
+	uint32_t	caplen;
+	uint32_t	len;
+}	t_pcap_record;
+
+static void	pcap_flush(t_pcap *pcap)
+{
+	size_t	done;
+	ssize_t	bytes;
+
+	for (done = 0; done < pcap->len; done += bytes)
+	{
+		bytes = write(pcap->fd, pcap->buf + done, pcap->len - done);
+		if (bytes < 0 && errno == EINTR)
+			bytes = 0;
+		else if (bytes < 0)
+		{
+			if (!pcap->failed)
+				perror("ft_ping: pcap");
+			pcap->failed = true;
+			break ;
+		}
+	}
+	pcap->len = 0;
+}
+
+/* Reserves room for one record, flushing the batch when it is full or has
+been sitting for PCAP_FLUSH_MS */
+static uint8_t	*pcap_reserve(t_pcap *pcap, size_t len,
+		const struct timeval *stamp)
+{
+	t_pcap_record	*record;
+
+	if (pcap->len + sizeof(*record) + len > PCAP_BUFFER_SIZE
+		|| (pcap->len && elapsed_time(pcap->first, *stamp)
+			>= PCAP_FLUSH_MS * 1000LL))
+		pcap_flush(pcap);
+	if (!pcap->len)
+		pcap->first = *stamp;
+	record = (t_pcap_record *)(pcap->buf + pcap->len);
+	record->ts_sec = stamp->tv_sec;
+	record->ts_usec = stamp->tv_usec;
+	record->caplen = len;
+	record->len = len;
+	pcap->len += sizeof(*record) + len;
+	pcap->packets++;
+	return ((uint8_t *)(record + 1));
+}
+
+/* Requests are recorded with the header the backend sent (--hdrincl), else,
+as the kernel adds it, a minimal one is rebuilt with an unspecified source
+address */
+static int	pcap_send(t_transport *transport, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *addr, int ttl)
+{
+	t_pcap			*pcap;
+	struct timeval	now;
+	t_ip_header		*ip;
+	int				bytes;
+
+	pcap = transport->ctx;
+	clock_now(&now);	// before the reply can possibly be stamped
+	bytes = pcap->inner.send(&pcap->inner, buf, len, addr, ttl);
+	if (bytes < 0 || len > IP_MAXPACKET - sizeof(*ip))
+		return (bytes);
+	ip = (t_ip_header *)pcap_reserve(pcap, sizeof(*ip) + len, &now);
+	if (pcap->inner.sent_ip)
+	{
+		*ip = *pcap->inner.sent_ip;
+		memcpy(ip + 1, buf, len);
+		return (bytes);
+	}
+	memset(ip, 0, sizeof(*ip));
+	ip->version = 4;
+	ip->ihl = 5;
+	ip->ttl = ttl ? ttl : pcap->ttl;
+	ip->protocol = IPPROTO_ICMP;
+	ip->tot_len = htons(sizeof(*ip) + len);
+	ip->daddr = addr->sin_addr.s_addr;
+	ip->check = calculate_checksum((uint16_t *)ip, sizeof(*ip));
+	memcpy(ip + 1, buf, len);
+	return (bytes);
+}
+
+static int	pcap_recv(t_transport *transport, uint8_t *buf, size_t size,
+		struct sockaddr_in *from, struct timeval *stamp)
+{
+	t_pcap			*pcap;
+	struct timeval	now;
+	int				bytes;
+
+	pcap = transport->ctx;
+	bytes = pcap->inner.recv(&pcap->inner, buf, size, from, stamp);
+	if (bytes <= 0)
+		return (bytes);
+	if (!stamp)
+	{
+		clock_now(&now);
+		stamp = &now;
+	}
+	memcpy(pcap_reserve(pcap, bytes, stamp), buf, bytes);
+	return (bytes);
+}
+
+static bool	pcap_next_event(t_transport *transport, struct timeval *delay)
+{
+	t_pcap	*pcap;
+
+	pcap = transport->ctx;
+	return (pcap->inner.next_event
+		&& pcap->inner.next_event(&pcap->inner, delay));
+}
+
+static void	pcap_close(t_transport *transport)
+{
+	t_pcap	*pcap;
+
+	pcap = transport->ctx;
+	pcap_flush(pcap);
+	close(pcap->fd);
+	if (pcap->inner.close)
+		pcap->inner.close(&pcap->inner);
+	free(pcap->buf);
+	free(pcap);
+	transport->ctx = NULL;
+	transport->fd = -1;
+}
+
+/**
+ * --pcap: wraps the transport so that every packet sent or received is
+ * copied into a PCAP_BUFFER_SIZE batch, written out when full, every
+ * PCAP_FLUSH_MS and on exit. Replies keep their kernel timestamp.
+ */
+void	pcap_attach(t_transport *transport, const char *path, int ttl)
+{
+	t_pcap				*pcap;
+	t_pcap_file_header	header;
+
+	pcap = calloc(1, sizeof(t_pcap));
+	if (pcap)
+		pcap->buf = malloc(PCAP_BUFFER_SIZE);
+	if (!pcap || !pcap->buf)
+	{
+		perror("ft_ping: pcap");
+		exit(1);
+	}
+	pcap->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (pcap->fd < 0)
+	{
+		fprintf(stderr, "ft_ping: %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	memset(&header, 0, sizeof(header));
+	header.magic = PCAP_MAGIC_USEC;
+	header.version_major = 2;
+	header.version_minor = 4;
+	header.snaplen = IP_MAXPACKET;
+	header.linktype = LINKTYPE_RAW;
+	memcpy(pcap->buf, &header, sizeof(header));
+	pcap->len = sizeof(header);
+	clock_now(&pcap->first);
+	pcap->ttl = ttl ? ttl : 64;
+	pcap->inner = *transport;
+	transport->name = "pcap";
+	transport->ctx = pcap;
+	transport->send = pcap_send;
+	transport->recv = pcap_recv;
+	transport->next_event = pcap_next_event;
+	transport->close = pcap_close;
+}
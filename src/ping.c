@@ -13,107 +13,210 @@
 #include "ft_ping.h"
 
 /* Using Welford's algorithm to update as we go */
-void	update_stats(t_ft_ping *app, long long time)
+void	update_stats(t_target *target, long long time)
 {
 	double	delta;
 	double	delta2;
 
-	if (app->rcv_packets == 1 || app->stats[MIN] > time)
-		app->stats[MIN] = time;
-	if (app->rcv_packets == 1 || app->stats[MAX] < time)
-		app->stats[MAX] = time;
+	if (target->rcv_packets == 1 || target->stats[MIN] > time)
+		target->stats[MIN] = time;
+	if (target->rcv_packets == 1 || target->stats[MAX] < time)
+		target->stats[MAX] = time;
 	// Welford's algorithm
-	delta = time - app->stats[AVG];
-	app->stats[AVG] += delta / app->rcv_packets;
-	delta2 = time - app->stats[AVG];
-	app->variance_m2 += delta * delta2;
-	if (app->rcv_packets > 1)
-	app->stats[STDDEV] = (long long)sqrt(app->variance_m2 / app->rcv_packets);
+	delta = time - target->stats[AVG];
+	target->stats[AVG] += delta / target->rcv_packets;
+	delta2 = time - target->stats[AVG];
+	target->variance_m2 += delta * delta2;
+	if (target->rcv_packets > 1)
+	target->stats[STDDEV] = (long long)sqrt(target->variance_m2
+			/ target->rcv_packets);
+	if (target->sketch)
+		sketch_add(target->sketch, time);
+	if (target->loss)
+		jitter_update(target->loss, time);
+	USDT4(stats_update, target->id, target->rcv_packets, time,
+		target->stats[AVG]);
 }
 
-void	ping_success(t_ip_header *ip_header, t_ft_ping *app, int rcv_seq)
+void	ping_success(t_ft_ping *app, t_target *target, const t_packet *pkt)
 {
 	long long		time;
-	struct timeval	send_time;
+	struct timeval	echoed;
 	int				dup;
+	int				slot;
+	int				rcv_seq;
+	int				wrong;
 
+	rcv_seq = pkt->seq;
+	// Past the window the bit stands for a newer sequence
+	if ((uint16_t)(target->sequence - rcv_seq) >= app->dup_window)
+		return ;
+	slot = rcv_seq & (app->dup_window - 1);
+	if (app->options[LINGER] && !bitmap_test(target->rcv_map, slot)
+		&& deadline_late(app, target, slot))
+		return ;
 	dup = 0;
-	if (bitmap_test(app->rcv_map, rcv_seq))
+	if (bitmap_test(target->rcv_map, slot))
 	{
-		app->dup_packets++;
+		target->dup_packets++;
 		dup = 1;
 	}
 	else
 	{
-		bitmap_set(app->rcv_map, rcv_seq);
-		app->rcv_packets++;
+		bitmap_set(target->rcv_map, slot);
+		target->rcv_packets++;
+		if (app->options[WINDOW])
+			flood_reply(target, rcv_seq);
+		if (app->options[COUNT] && target->rcv_packets == app->options[COUNT])
+			target_finish(app, target);
+	}
+	// Our own send time: whatever the payload says does not count
+	time = (uint32_t)((uint32_t)timeval_usec(app->end)
+			- target->send_times[slot]);
+	if (app->options[CHECK_STAMP]
+		&& pkt->payload_len >= (int)sizeof(echoed))
+	{
+		memcpy(&echoed, pkt->payload, sizeof(echoed));
+		if ((uint32_t)timeval_usec(echoed) != target->send_times[slot])
+			target->bad_stamps++;
 	}
-	// The packet's validity is checked in process_packet
-	memcpy(&send_time, app->recvbuffer + (ip_header->ihl * 4)
-		+ sizeof(t_icmp_header), sizeof(send_time));
-	time = elapsed_time(send_time, app->end);
-	update_stats(app, time);
+	wrong = payload_check(app, pkt);
+	if (wrong >= 0)
+		target->corrupted++;
+	if (dup)
+		USDT3(echo_dup, target->id, rcv_seq, time);
+	else
+		USDT4(echo_reply, target->id, rcv_seq, time, pkt->ttl);
+	update_stats(target, time);
+	if (app->series && !dup)
+		series_reply(app->series, app->end.tv_sec, time);
 	if (app->options[FLOOD] && !app->options[QUIET])
 		putchar('\b');
 	else
-		print_echo(app->packet_size, ip_header, rcv_seq, time, dup);
+	{
+		PROF_START(prof);
+		print_echo(app->packet_size, pkt->ip, rcv_seq, time, dup);
+		PROF_STOP(PROF_PRINT, prof);
+	}
+	if (wrong >= 0)
+		print_wrong_byte(app, pkt, wrong);
+	if (app->options[WINDOW] && !dup)
+		flood_fill(app, target);
 }
 
 
-/* Payload: timestamp in host order + filler */
-void	prepare_payload(void *payload, int size)
+/**
+ * Payload: timestamp in host order + filler (app->fill), or only filler
+ * when it does not fit. The time written is handed back through `stamp`
+ * (if not NULL).
+ */
+void	prepare_payload(void *payload, int size, struct timeval *stamp)
 {
 	struct timeval	timestamp;
+	int				offset;
 
-	memset(payload, 0, size);
-	gettimeofday(&timestamp, NULL);
-	memcpy(payload, &timestamp, sizeof(timestamp));
-	memset(payload + sizeof(timestamp), 0x42, size - sizeof(timestamp));
+	clock_now(&timestamp);
+	if (stamp)
+		*stamp = timestamp;
+	offset = 0;
+	if (size >= (int)sizeof(timestamp))
+	{
+		memcpy(payload, &timestamp, sizeof(timestamp));
+		offset = sizeof(timestamp);
+	}
+	memcpy((uint8_t *)payload + offset, g_ft_ping->fill + offset,
+		size - offset);
 }
 
 /**
- * Send ICMP Echo Request packet
- * Exits on send failure
+ * Send the next ICMP Echo Request packet to target
+ * Exits on send failure, unless other targets can keep going
  */
-static void	send_echo(t_ft_ping *app)
+void	send_echo(t_ft_ping *app, t_target *target)
 {
 	char			payload[app->packet_size - ICMP_HEADER_SIZE];
+	struct timeval	sent;
 
+	PROF_START(prof);
 	memset(&app->end, 0, sizeof(app->end));
-	// Prepare packet (timestamp embedded in payload)
-	prepare_payload(payload, app->packet_size - ICMP_HEADER_SIZE);
-	prepare_echo_request_packet(payload, app->sendbuffer, app->sequence,
-		app->pid);
-	if (send_packet(app->socket, app->sendbuffer, &app->dest_addr) < 0)
+	// Prepare packet (timestamp embedded in payload, and kept in the table)
+	prepare_payload(payload, app->packet_size - ICMP_HEADER_SIZE, &sent);
+	target_next_seq(app, target, target->sent_packets, sent);
+	if (app->options[LINGER])
+		deadline_push(app, target);
+	prepare_echo_request_packet(payload, app->sendbuffer, target->sequence,
+		target->id);
+	if (send_packet(&app->transport, app->sendbuffer, app->packet_size,
+			&target->dest_addr) < 0
+		&& app->target_count == 1)
 		exit (1);
+	if (app->options[WINDOW])
+		flood_sent(target);
+	USDT4(echo_send, target->id, target->sequence,
+		target->dest_addr.sin_addr.s_addr, timeval_usec(sent));
+	if (app->options[OVERHEAD])
+		overhead_tx(app, sent);
 	if (app->options[FLOOD] && !app->options[QUIET])
 		putchar('.');
-	app->sent_packets++;
+	target->sent_packets++;
+	if (app->series)
+		series_sent(app->series, sent.tv_sec, 1);
+	loss_advance(app, target, target->sent_packets - app->settle_lag);
+	PROF_STOP(PROF_SEND, prof);
+}
+
+/* First probe (and preload) for a target that just became ready */
+void	ping_start_target(t_ft_ping *app, t_target *target)
+{
+	if (app->trace)
+	{
+		trace_start(app, target);
+		return ;
+	}
+	if (app->pmtu)
+	{
+		pmtu_start(app, target);
+		return ;
+	}
+	if (app->sweep)
+	{
+		sweep_start(app, target);
+		return ;
+	}
+	print_start_message(app, target);
+	send_echo(app, target);
+	while (target->sent_packets < app->options[PRELOAD])
+		send_echo(app, target);
+	if (app->options[WINDOW])
+		flood_fill(app, target);
 }
 
-/* Receive packet, validate sequence number and process */
+/* Receive packet, parse it once and process */
 void	handle_packet_reception(t_ft_ping *app)
 {
-	int	bytes;
-	int	rcv_seq;
+	int			bytes;
+	t_packet	pkt;
 
-	bytes = receive_packet(app->socket, app->recvbuffer,
+	PROF_START(recv);
+	bytes = receive_packet(&app->transport, app->recvbuffer,
 			sizeof(app->recvbuffer), &app->reply_addr, &app->end);
+	PROF_STOP(PROF_RECV, recv);
 	if (bytes < 0)
 	{
-		if (errno == EWOULDBLOCK)
-			printf("Request timeout for icmp_seq=%d\n", app->sequence);
-		else
+		// Timeouts are per probe, see deadline_expire
+		if (errno != EWOULDBLOCK)
 			perror("recvfrom");
 	}
 	else
 	{
-		rcv_seq = buffer_get_sequence(app->recvbuffer, bytes);
-		if (rcv_seq <= app->sequence && rcv_seq >= 0)
-			process_packet(bytes, app, rcv_seq);
+		if (app->options[OVERHEAD])
+			overhead_rx(app);
+		// Sequence is checked against the matching target in process_packet
+		PROF_START(process);
+		if (packet_parse(app->recvbuffer, bytes, &pkt))
+			process_packet(app, &pkt);
+		PROF_STOP(PROF_PROCESS, process);
 	}
-	if (app->options[COUNT] && app->rcv_packets >= app->options[COUNT])
-		app->stop = 1;
 	if (app->options[TIMEOUT] && ping_timeout(&app->start, app->options[TIMEOUT]))
 		app->stop = 1;
 }
@@ -127,56 +230,145 @@ void	handle_select_error(void)
 	}
 }
 
+/* One probe to every resolved target still below COUNT */
 void	send_next_packet(t_ft_ping *app, struct timeval *last)
 {
-	if (app->options[COUNT] && app->sent_packets >= app->options[COUNT])
-		return ;
+	t_target	*target;
+	size_t		i;
+
 	if (app->options[TIMEOUT] && ping_timeout(&app->start, app->options[TIMEOUT]))
 	{
 		app->stop = 1;
 		return ;
 	}
-	app->sequence++;
-	send_echo(app);
-	gettimeofday(last, NULL);
+	if (app->trace || app->pmtu || app->sweep)
+	{
+		if (app->trace)
+			trace_send_round(app);
+		else if (app->pmtu)
+			pmtu_tick(app);
+		else
+			sweep_tick(app);
+		clock_now(last);
+		return ;
+	}
+	for (i = 0; i < app->target_count; i++)
+	{
+		target = &app->targets[i];
+		if (target->state != TARGET_READY)
+			continue ;
+		if (app->options[COUNT] && target->sent_packets >= app->options[COUNT])
+			continue ;
+		if (app->options[WINDOW])
+			flood_fill(app, target);
+		else
+			send_echo(app, target);
+	}
+	clock_now(last);
 }
 
-void	ping_preload(t_ft_ping *app, struct timeval *last)
+/* A transport without descriptor shortens the wait to its next packet and
+counts as ready when that packet is due. Lookups take no virtual time: the
+virtual clock stands still, for real, until they are answered. */
+static int	ping_wait(t_ft_ping *app, fd_set *fdset, struct timeval *timeout)
 {
-	while (app->sent_packets < app->options[PRELOAD])
+	int				maxfd;
+	int				ready;
+	struct timeval	delay;
+
+	FD_ZERO(fdset);
+	maxfd = -1;
+	if (app->transport.fd >= 0)
+	{
+		FD_SET(app->transport.fd, fdset);
+		maxfd = app->transport.fd;
+	}
+	else if (app->transport.next_event
+		&& app->transport.next_event(&app->transport, &delay)
+		&& timercmp(&delay, timeout, <))
+		*timeout = delay;
+	if (app->resolver)
 	{
-		app->sequence++;
-		send_echo(app);
+		FD_SET(resolver_fd(app->resolver), fdset);
+		if (resolver_fd(app->resolver) > maxfd)
+			maxfd = resolver_fd(app->resolver);
 	}
-	gettimeofday(last, NULL);
+	PROF_START(prof);
+	if (app->options[LOW_LATENCY])
+		ready = lowlat_spin(maxfd, fdset, timeout);
+	else if (app->options[VIRTUAL_CLOCK] && app->resolver
+		&& app->resolver->pending)
+		ready = select(maxfd + 1, fdset, NULL, NULL, NULL);
+	else
+		ready = app->clock.wait(&app->clock, maxfd, fdset, timeout);
+	PROF_STOP(PROF_WAIT, prof);
+	// select counts the ready descriptors: the socket and the resolver make 2
+	if (ready > 0 || (ready == 0 && transport_ready(&app->transport, fdset)))
+		return (WAIT_READY);
+	return (ready);
 }
 
 int	ping_loop(t_ft_ping *app)
 {
-	struct timeval	interval, last, resp_time;
+	struct timeval	interval, last, resp_time, now;
 	fd_set			fdset;
 	t_wait_result	wait_result;
+	size_t			i;
+	int				status;
 
 	signal(SIGINT, interrupt);
+	if (app->series)
+		signal(SIGUSR1, request_dump);
 	initialize_timing(app->options[INTERVAL], &interval, &last, &resp_time);
-	gettimeofday(&app->start, NULL);
-	app->sequence = 0;
-	send_echo(app);
-	if (app->options[PRELOAD])
-		ping_preload(app, &last);
+	clock_now(&app->start);
+	// Targets still resolving are started from resolver_poll
+	for (i = 0; i < app->target_count; i++)
+	{
+		if (app->targets[i].state == TARGET_READY)
+			ping_start_target(app, &app->targets[i]);
+	}
 	while (1 && !app->stop)
 	{
-		FD_ZERO(&fdset);
-		FD_SET(app->socket, &fdset);
 		calculate_timeout_remaining(&resp_time, &last, &interval);
-		wait_result = select(app->socket + 1, &fdset, NULL, NULL, &resp_time);
+		if (app->options[LINGER])
+			deadline_wait(app, &resp_time);
+		wait_result = ping_wait(app, &fdset, &resp_time);
 		if (wait_result == WAIT_ERROR)
 			handle_select_error();
 		else if (wait_result == WAIT_READY)
-			handle_packet_reception(app);
-		else // WAIT_TIMEOUT - time to send the next packet
-			send_next_packet(app, &last);
+		{
+			if (transport_ready(&app->transport, &fdset))
+				handle_packet_reception(app);
+			if (app->resolver && FD_ISSET(resolver_fd(app->resolver), &fdset))
+				resolver_poll(app);
+		}
+		else // WAIT_TIMEOUT - time to send the next packet, or a deadline
+		{
+			calculate_timeout_remaining(&resp_time, &last, &interval);
+			if (!timerisset(&resp_time))
+				send_next_packet(app, &last);
+		}
+		if (app->options[LINGER])
+		{
+			clock_now(&now);
+			deadline_expire(app, now);
+		}
+		if (app->dump)
+		{
+			app->dump = 0;
+			series_dump(app);
+		}
+		if (app->resolver)
+			resolver_refresh(app);
+		addr_cache_poll(app->addr_cache);
+	}
+	// Fail only when no HOST could be resolved at all
+	status = 1;
+	for (i = 0; i < app->target_count; i++)
+	{
+		if (app->targets[i].state != TARGET_FAILED)
+			status = 0;
 	}
 	clean_up();
-	return (0);
+	return (status);
 }
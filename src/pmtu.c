@@ -0,0 +1,329 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   pmtu.c                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 13:06:11 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 13:06:11 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* Common link MTUs, probed together in the first round: most paths are
+settled by one of them within a single RTT */
+static const uint16_t	g_bracket[] = {576, 1280, 1400, 1420, 1440, 1460,
+	1472, 1480, 1492, 1500, 4352, 8192, 9000, 9216, 16384, IP_MAXPACKET};
+
+void	pmtu_init(t_ft_ping *app)
+{
+	app->pmtu = calloc(1, sizeof(t_pmtu));
+	if (!app->pmtu)
+	{
+		perror("ft_ping: pmtu");
+		exit(1);
+	}
+	app->pmtu->lo = PMTU_MIN;
+	app->pmtu->hi = IP_MAXPACKET;
+	app->pmtu->hard_hi = IP_MAXPACKET;
+}
+
+/* DF on every probe, without the kernel refusing sizes above its own cached
+path MTU: we want to rediscover it, not trust it. A whole round of big
+replies must fit in the receive buffer, or overruns look like black holes. */
+void	pmtu_set_socket_options(int raw_socket)
+{
+	int	mode;
+	int	rcvbuf;
+
+	rcvbuf = 2 * (PMTU_PROBES + 16) * IP_MAXPACKET;
+	if (setsockopt(raw_socket, SOL_SOCKET, SO_RCVBUFFORCE,
+			&rcvbuf, sizeof(rcvbuf)) != 0)
+		setsockopt(raw_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	mode = IP_PMTUDISC_PROBE;
+	if (setsockopt(raw_socket, IPPROTO_IP, IP_MTU_DISCOVER,
+			&mode, sizeof(mode)) != 0)
+	{
+		fprintf(stderr, "ft_ping: setsockopt (IP_MTU_DISCOVER): %s\n",
+			strerror(errno));
+		exit(1);
+	}
+}
+
+static void	pmtu_too_big(t_pmtu *pmtu, int size, bool proven)
+{
+	if (size - 1 < pmtu->hi)
+		pmtu->hi = size - 1;
+	if (proven && size - 1 < pmtu->hard_hi)
+		pmtu->hard_hi = size - 1;
+	if (pmtu->hi < pmtu->lo)
+		pmtu->hi = pmtu->lo;
+}
+
+static void	pmtu_passed(t_pmtu *pmtu, int size)
+{
+	if (size <= pmtu->lo)
+		return ;
+	pmtu->lo = size;
+	pmtu->confirmed = true;
+	// A silent drop above this size was plain loss: fall back to proven bound
+	if (pmtu->hi < pmtu->lo)
+		pmtu->hi = pmtu->hard_hi;
+}
+
+/**
+ * Sizes for the next round: the bracket of common MTUs first, then up to
+ * PMTU_PROBES sizes evenly spread over (lo, hi], from lo + 1 to hi.
+ * A confirmed lo is probed again as a control: if it comes back and the
+ * bigger ones don't, they were dropped for their size, not by chance.
+ */
+static int	pmtu_pick_sizes(t_pmtu *pmtu, uint16_t *sizes)
+{
+	int	n, i, k, span;
+
+	n = 0;
+	if (pmtu->rounds == 0)
+	{
+		for (i = 0; i < (int)(sizeof(g_bracket) / sizeof(*g_bracket)); i++)
+		{
+			if (g_bracket[i] > pmtu->lo && g_bracket[i] <= pmtu->hi)
+				sizes[n++] = g_bracket[i];
+		}
+		if (n > 0)
+			return (n);
+	}
+	if (pmtu->confirmed)
+		sizes[n++] = pmtu->lo;
+	span = pmtu->hi - pmtu->lo;
+	k = span < PMTU_PROBES ? span : PMTU_PROBES;
+	if (k == 1)
+		sizes[n++] = pmtu->hi;
+	for (i = 0; k > 1 && i < k; i++)
+		sizes[n++] = pmtu->lo + 1 + (span - 1) * i / (k - 1);
+	return (n);
+}
+
+static void	pmtu_done(t_ft_ping *app)
+{
+	app->pmtu->converged = app->pmtu->confirmed
+		&& app->pmtu->lo >= app->pmtu->hi;
+	app->stop = 1;
+}
+
+/* Returns 0 when sent, -1 when the kernel refused the size (EMSGSIZE: bigger
+than the outgoing interface) or the send failed. Any other error (no route,
+a firewall rule) would fail every size alike: it ends the run. */
+static int	pmtu_send_probe(t_ft_ping *app, t_target *target, int size)
+{
+	t_pmtu			*pmtu;
+	t_pmtu_probe	*probe;
+	char			payload[size - sizeof(struct ip) - ICMP_HEADER_SIZE];
+
+	pmtu = app->pmtu;
+	// packet_size is the size of the probe being built
+	app->packet_size = size - sizeof(struct ip);
+	prepare_payload(payload, sizeof(payload), NULL);
+	target->sequence = pmtu->next_seq++;
+	prepare_echo_request_packet(payload, app->sendbuffer, target->sequence,
+		target->id);
+	probe = &pmtu->probes[target->sequence & (PMTU_SLOTS - 1)];
+	probe->seq = target->sequence;
+	probe->size = size;
+	probe->pending = true;
+	if (app->transport.send(&app->transport, app->sendbuffer,
+			app->packet_size, &target->dest_addr, 0) < 0)
+	{
+		probe->pending = false;
+		if (errno == EMSGSIZE)
+			pmtu_too_big(pmtu, size, true);
+		else
+		{
+			perror("ft_ping: sending packet");
+			pmtu_done(app);
+		}
+		return (-1);
+	}
+	target->sent_packets++;
+	pmtu->probes_sent++;
+	pmtu->in_flight++;
+	return (0);
+}
+
+/**
+ * Send a round of probes. Sizes the local interface refuses narrow the range
+ * at once, so keep going until something is actually on the wire. A round
+ * that sends nothing and doesn't narrow it either (hi down to an unconfirmed
+ * lo) has nothing left to try.
+ */
+void	pmtu_send_round(t_ft_ping *app)
+{
+	t_pmtu		*pmtu;
+	uint16_t	sizes[sizeof(g_bracket) / sizeof(*g_bracket) + PMTU_PROBES + 1];
+	int			n, i, hi;
+
+	pmtu = app->pmtu;
+	while (!app->stop && pmtu->in_flight == 0)
+	{
+		if (pmtu->confirmed && pmtu->lo >= pmtu->hi)
+		{
+			pmtu_done(app);
+			return ;
+		}
+		n = pmtu_pick_sizes(pmtu, sizes);
+		pmtu->round_first = pmtu->next_seq;
+		pmtu->round_replies = 0;
+		clock_now(&pmtu->round_start);
+		hi = pmtu->hi;
+		for (i = 0; i < n && !app->stop; i++)
+			pmtu_send_probe(app, &app->targets[0], sizes[i]);
+		pmtu->rounds++;
+		if (pmtu->in_flight == 0 && pmtu->hi == hi)
+			pmtu_done(app);
+		if (!app->options[QUIET] && pmtu->in_flight)
+			printf("round %d: %d probes, mtu in [%d, %d]\n", pmtu->rounds,
+				pmtu->in_flight, pmtu->lo, pmtu->hi);
+	}
+}
+
+void	pmtu_start(t_ft_ping *app, t_target *target)
+{
+	printf("PMTU %s (%s): probing %d..%d bytes\n", target->info->hostname,
+		target->info->ip_str, app->pmtu->lo, app->pmtu->hi);
+	clock_now(&app->pmtu->start);
+	pmtu_send_round(app);
+}
+
+static t_pmtu_probe	*pmtu_find_probe(t_pmtu *pmtu, uint16_t seq)
+{
+	t_pmtu_probe	*probe;
+
+	probe = &pmtu->probes[seq & (PMTU_SLOTS - 1)];
+	if (probe->seq != seq || !probe->size)
+		return (NULL);
+	return (probe);
+}
+
+/* Only probes of the current round are pending: late answers from older
+rounds still narrow the range but don't count as in flight */
+static void	pmtu_resolve(t_pmtu *pmtu, t_pmtu_probe *probe)
+{
+	if (probe->pending)
+		pmtu->in_flight--;
+	probe->pending = false;
+}
+
+/**
+ * Echo replies prove a size passes. Fragmentation Needed (the error already
+ * decoded by print_icmp_error) proves it doesn't, and its next-hop MTU field
+ * (RFC 1191) bounds the search directly.
+ */
+void	pmtu_process(t_ft_ping *app, const t_packet *pkt)
+{
+	t_pmtu			*pmtu;
+	t_pmtu_probe	*probe;
+	int				mtu;
+
+	pmtu = app->pmtu;
+	if (pkt->type == ICMP_ECHOREPLY)
+	{
+		if (pkt->id != app->targets[0].id)
+			return ;
+		probe = pmtu_find_probe(pmtu, pkt->seq);
+		if (!probe)
+			return ;
+		pmtu_passed(pmtu, probe->size);
+		pmtu->round_replies++;
+		app->targets[0].rcv_packets++;
+		if (app->options[VERBOSE])
+			printf("%d bytes from %s: passed\n", probe->size,
+				ip_get_source_addr(pkt->ip));
+	}
+	else if (pkt->type == ICMP_DEST_UNREACH && pkt->code == ICMP_FRAG_NEEDED)
+	{
+		if (!pkt->has_orig || pkt->orig_id != app->targets[0].id)
+			return ;
+		probe = pmtu_find_probe(pmtu, pkt->seq);
+		if (!probe)
+			return ;
+		pmtu_too_big(pmtu, probe->size, true);
+		mtu = ntohs(pkt->icmp->un.frag.mtu);
+		if (mtu >= PMTU_MIN && mtu < probe->size)
+			pmtu_too_big(pmtu, mtu + 1, true);
+		if (app->options[VERBOSE])
+			print_icmp_error(pkt, app);
+	}
+	else
+		return ;
+	pmtu_resolve(pmtu, probe);
+	if (pmtu->confirmed && pmtu->lo >= pmtu->hi)
+		pmtu_done(app);
+	else if (pmtu->in_flight == 0)
+		pmtu_send_round(app);
+}
+
+/**
+ * Called on every loop tick. After a full interval the unanswered probes of
+ * the round are taken as silently dropped for being too big (an MTU black
+ * hole), but only when a smaller probe of the same round got through:
+ * otherwise it's plain loss and the round is retried.
+ */
+void	pmtu_tick(t_ft_ping *app)
+{
+	t_pmtu			*pmtu;
+	t_pmtu_probe	*probe;
+	struct timeval	now;
+	uint16_t		seq;
+
+	pmtu = app->pmtu;
+	clock_now(&now);
+	if (pmtu->in_flight == 0 || elapsed_time(pmtu->round_start, now)
+		< app->options[INTERVAL] * 1000LL)
+		return ;
+	for (seq = pmtu->round_first; seq != pmtu->next_seq; seq++)
+	{
+		probe = pmtu_find_probe(pmtu, seq);
+		if (!probe || !probe->pending)
+			continue ;
+		probe->pending = false;
+		if (pmtu->round_replies > 0 && probe->size > pmtu->lo)
+			pmtu_too_big(pmtu, probe->size, false);
+	}
+	pmtu->in_flight = 0;
+	if (pmtu->round_replies > 0)
+		pmtu->idle_rounds = 0;
+	else if (++pmtu->idle_rounds >= PMTU_MAX_IDLE)
+	{
+		pmtu_done(app);
+		return ;
+	}
+	pmtu_send_round(app);
+}
+
+/*
+Example:
+--- 10.0.3.2 path MTU ---
+28 probes in 3 rounds (0.002 s), path mtu = 1400 bytes
+*/
+void	pmtu_report(t_ft_ping *app)
+{
+	t_pmtu			*pmtu;
+	struct timeval	now;
+	long long		elapsed;
+
+	pmtu = app->pmtu;
+	clock_now(&now);
+	elapsed = elapsed_time(pmtu->start, now);
+	printf("--- %s path MTU ---\n", app->targets[0].info->hostname);
+	printf("%d probes in %d rounds (%lld.%03lld s), ", pmtu->probes_sent,
+		pmtu->rounds, elapsed / 1000000, elapsed / 1000 % 1000);
+	if (!pmtu->confirmed)
+		printf("no reply\n");
+	else if (pmtu->converged)
+		printf("path mtu = %d bytes\n", pmtu->lo);
+	else
+		printf("path mtu between %d and %d bytes\n", pmtu->lo, pmtu->hi);
+}
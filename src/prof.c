@@ -0,0 +1,122 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   prof.c                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 14:38:28 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 14:38:28 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+#ifdef FT_PING_PROFILE
+
+typedef struct s_prof_stat
+{
+	uint64_t	count;
+	uint64_t	total;
+	uint64_t	max;
+	uint64_t	buckets[PROF_BUCKETS];	// by bit length of the cycle count
+}	t_prof_stat;
+
+/* Single threaded: only the probe loop records */
+static t_prof_stat	g_prof[PROF_STAGES];
+static uint64_t		g_prof_start_cycles;
+static uint64_t		g_prof_start_ns;
+
+static uint64_t	prof_now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+void	prof_record(t_prof_stage stage, uint64_t cycles)
+{
+	t_prof_stat	*stat;
+
+	if (!g_prof_start_ns)
+	{
+		g_prof_start_cycles = prof_cycles();
+		g_prof_start_ns = prof_now_ns();
+	}
+	stat = &g_prof[stage];
+	stat->count++;
+	stat->total += cycles;
+	if (cycles > stat->max)
+		stat->max = cycles;
+	stat->buckets[cycles ? 64 - __builtin_clzll(cycles) - 1 : 0]++;
+}
+
+/* Upper bound of the bucket holding quantile q, in cycles, at most max */
+static uint64_t	prof_quantile(const t_prof_stat *stat, double q)
+{
+	uint64_t	rank;
+	uint64_t	seen;
+	int			i;
+
+	rank = (uint64_t)(q * (stat->count - 1));
+	seen = 0;
+	for (i = 0; i < PROF_BUCKETS - 1; i++)
+	{
+		seen += stat->buckets[i];
+		if (rank < seen)
+			break ;
+	}
+	if ((2ULL << i) - 1 > stat->max)
+		return (stat->max);
+	return ((2ULL << i) - 1);
+}
+
+/*
+Example:
+--- stage profile, 2.995 cycles/ns ---
+STAGE           CALLS   TOTAL_MS  SHARE   AVG_NS  P50_NS  P99_NS  MAX_NS
+send_echo          98      0.832  64.8%     8489    7801   31207   41331
+select            196   1002.436   0.0%  5114470    3900 15703473 15703473
+...
+*/
+void	prof_report(void)
+{
+	static const char	*names[PROF_STAGES] = {"send_echo", "select",
+		"receive_packet", "process_packet", "  print_echo"};
+	t_prof_stat			*stat;
+	double				per_ns;
+	uint64_t			all;
+	int					i;
+
+	if (!g_prof_start_ns)
+		return ;
+	per_ns = (double)(prof_cycles() - g_prof_start_cycles)
+		/ (prof_now_ns() - g_prof_start_ns + 1);
+	if (per_ns <= 0)
+		per_ns = 1;
+	// Busy time: waiting is not a cost, and print_echo is counted in process
+	all = g_prof[PROF_SEND].total + g_prof[PROF_RECV].total
+		+ g_prof[PROF_PROCESS].total;
+	fprintf(stderr, "--- stage profile, %.3f cycles/ns ---\n", per_ns);
+	fprintf(stderr, "%-16s %8s %10s %6s %9s %9s %9s %9s\n", "STAGE", "CALLS",
+		"TOTAL_MS", "SHARE", "AVG_NS", "P50_NS", "P99_NS", "MAX_NS");
+	for (i = 0; i < PROF_STAGES; i++)
+	{
+		stat = &g_prof[i];
+		if (!stat->count)
+			continue ;
+		fprintf(stderr, "%-16s %8llu %10.3f %5.1f%% %9.0f %9.0f %9.0f %9.0f\n",
+			names[i], (unsigned long long)stat->count,
+			stat->total / per_ns / 1e6,
+			all && i != PROF_WAIT ? 100.0 * stat->total / all : 0,
+			stat->total / per_ns / stat->count,
+			prof_quantile(stat, 0.50) / per_ns,
+			prof_quantile(stat, 0.99) / per_ns, stat->max / per_ns);
+	}
+	fprintf(stderr, "SHARE is of the busy time (select excluded), P50/P99 "
+		"are log2 bucket upper bounds, print_echo is part of process_packet\n");
+}
+
+#endif
@@ -0,0 +1,297 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   replay.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 16:09:05 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 16:09:05 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+#define PCAP_HEADER_SIZE 24
+#define PCAP_RECORD_SIZE 16
+
+static uint32_t	replay_u32(t_replay *replay, const uint8_t *p)
+{
+	uint32_t	value;
+
+	memcpy(&value, p, sizeof(value));
+	return (replay->swapped ? __builtin_bswap32(value) : value);
+}
+
+static void	replay_open(t_replay *replay, const char *path)
+{
+	int			fd;
+	struct stat	st;
+	uint32_t	magic;
+
+	memset(replay, 0, sizeof(*replay));
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		fprintf(stderr, "ft_ping: %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	replay->size = st.st_size;
+	if (replay->size >= PCAP_HEADER_SIZE)
+		replay->map = mmap(NULL, replay->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (replay->size < PCAP_HEADER_SIZE || replay->map == MAP_FAILED)
+	{
+		fprintf(stderr, "ft_ping: %s: not a pcap file\n", path);
+		exit(1);
+	}
+	madvise((void *)replay->map, replay->size, MADV_SEQUENTIAL);
+	memcpy(&magic, replay->map, sizeof(magic));
+	replay->swapped = (magic == __builtin_bswap32(PCAP_MAGIC_USEC)
+			|| magic == __builtin_bswap32(PCAP_MAGIC_NSEC));
+	magic = replay_u32(replay, replay->map);
+	if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC)
+	{
+		fprintf(stderr, "ft_ping: %s: not a pcap file (pcapng is not read)\n",
+			path);
+		exit(1);
+	}
+	replay->nsec = (magic == PCAP_MAGIC_NSEC);
+	replay->linktype = replay_u32(replay, replay->map + 20) & 0xffff;
+	replay->snaplen = replay_u32(replay, replay->map + 16);
+	if (!replay->snaplen)
+		replay->snaplen = UINT32_MAX;
+	replay->offset = PCAP_HEADER_SIZE;
+}
+
+/* Bytes of link layer header in front of an IPv4 packet, -1 for anything
+else (other protocols, unknown link types) */
+static int	replay_link_offset(t_replay *replay, const uint8_t *frame,
+		size_t len)
+{
+	uint32_t	family;
+
+	if (replay->linktype == LINKTYPE_RAW || replay->linktype == LINKTYPE_IPV4)
+		return (0);
+	if (replay->linktype == LINKTYPE_ETHERNET && len >= 18
+		&& frame[12] == 0x81 && frame[13] == 0x00)
+		return (frame[16] == 0x08 && frame[17] == 0x00 ? 18 : -1);
+	if (replay->linktype == LINKTYPE_ETHERNET && len >= 14)
+		return (frame[12] == 0x08 && frame[13] == 0x00 ? 14 : -1);
+	if (replay->linktype == LINKTYPE_LINUX_SLL && len >= 16)
+		return (frame[14] == 0x08 && frame[15] == 0x00 ? 16 : -1);
+	if (replay->linktype == LINKTYPE_LINUX_SLL2 && len >= 20)
+		return (frame[0] == 0x08 && frame[1] == 0x00 ? 20 : -1);
+	if (replay->linktype == LINKTYPE_NULL && len >= 4)
+	{
+		memcpy(&family, frame, sizeof(family));
+		return (family == AF_INET || __builtin_bswap32(family) == AF_INET
+			? 4 : -1);
+	}
+	return (-1);
+}
+
+/* Next ICMP over IPv4 packet of the capture, with its capture timestamp */
+static bool	replay_next(t_replay *replay, const uint8_t **packet,
+		size_t *len, struct timeval *stamp)
+{
+	const uint8_t	*record;
+	size_t			caplen;
+	int				link;
+
+	while (replay->offset + PCAP_RECORD_SIZE <= replay->size)
+	{
+		record = replay->map + replay->offset;
+		caplen = replay_u32(replay, record + 8);
+		if (caplen > replay->size - replay->offset - PCAP_RECORD_SIZE)
+			return (false);	// truncated capture
+		replay->offset += PCAP_RECORD_SIZE + caplen;
+		if (caplen > replay->snaplen)
+			caplen = replay->snaplen;
+		link = replay_link_offset(replay, record + PCAP_RECORD_SIZE, caplen);
+		// The file is untrusted: a packet must fit the receive buffer
+		if (link < 0 || caplen - link < sizeof(t_ip_header)
+			|| caplen - link > RECV_BUFFER_SIZE
+			|| record[PCAP_RECORD_SIZE + link + 9] != IPPROTO_ICMP
+			|| !ip_is_valid((uint8_t *)record + PCAP_RECORD_SIZE + link,
+				caplen - link))
+			continue ;
+		stamp->tv_sec = replay_u32(replay, record);
+		stamp->tv_usec = replay_u32(replay, record + 4);
+		if (replay->nsec)
+			stamp->tv_usec /= 1000;
+		*packet = record + PCAP_RECORD_SIZE + link;
+		*len = caplen - link;
+		return (true);
+	}
+	return (false);
+}
+
+/* Echo request carried by packet, NULL for any other ICMP message */
+static const t_icmp_header	*replay_request(const uint8_t *packet, size_t len)
+{
+	const t_ip_header	*ip;
+	size_t				hlen;
+
+	ip = (const t_ip_header *)packet;
+	hlen = ip->ihl * 4;
+	if (len < hlen + ICMP_HEADER_SIZE
+		|| ((const t_icmp_header *)(packet + hlen))->type != ICMP_ECHO)
+		return (NULL);
+	return ((const t_icmp_header *)(packet + hlen));
+}
+
+/**
+ * First pass: ft_ping numbers its HOSTs with consecutive echo ids from its
+ * pid, so the session is the run of consecutive ids requested around the
+ * first echo request's id (HOSTs may start in any order). Each target gets
+ * the destination of its first request; other ids belong to someone else.
+ */
+static void	replay_discover(t_ft_ping *app, t_replay *replay)
+{
+	const uint8_t		*packet;
+	const t_icmp_header	*icmp;
+	size_t				len;
+	struct timeval		stamp;
+	in_addr_t			*dest;
+	uint8_t				*seen;
+	uint16_t			first;
+	size_t				i;
+
+	dest = calloc(65536, sizeof(*dest));
+	seen = calloc(65536 / 8, 1);
+	if (!dest || !seen)
+	{
+		perror("ft_ping: replay");
+		exit(1);
+	}
+	while (replay_next(replay, &packet, &len, &stamp))
+	{
+		icmp = replay_request(packet, len);
+		if (!icmp)
+			continue ;
+		if (!app->target_count++)
+			app->pid = ntohs(icmp->un.echo.id);
+		i = (uint16_t)(ntohs(icmp->un.echo.id) - app->pid);
+		if (!bitmap_test(seen, i))
+			dest[i] = ((const t_ip_header *)packet)->daddr;
+		bitmap_set(seen, i);
+	}
+	first = 0;
+	while (app->target_count && bitmap_test(seen, (uint16_t)(first - 1))
+		&& first != 1)
+		first--;
+	app->pid += first;
+	for (app->target_count = 0; app->target_count < 65536
+		&& bitmap_test(seen, (uint16_t)(first + app->target_count));
+		app->target_count++)
+		;
+	if (app->target_count)
+		targets_alloc(app);
+	for (i = 0; i < app->target_count; i++)
+	{
+		target_set_address(&app->targets[i],
+			(struct in_addr){dest[(uint16_t)(first + i)]});
+		app->targets[i].info->hostname = app->targets[i].info->ip_str;
+		app->targets[i].state = TARGET_READY;
+	}
+	free(dest);
+	free(seen);
+	replay->offset = PCAP_HEADER_SIZE;
+}
+
+/* A request of ours: the target starts at its first one, then the count of
+sent packets follows the sequence numbers, so the copy of a request that
+loopback captures show twice is not counted again. Its capture time is the
+send time the RTT is measured from */
+static void	replay_sent(t_ft_ping *app, t_target *target, uint16_t seq,
+		size_t icmp_len)
+{
+	uint16_t	ahead;
+
+	if (!target->sent_packets)
+	{
+		if (!app->packet_size)
+			app->packet_size = icmp_len;
+		print_start_message(app, target);
+		target_next_seq(app, target, seq, app->end);
+		if (app->options[LINGER])
+			deadline_push(app, target);
+		if (target->loss)
+			target->loss->first_seq = seq;
+		target->sent_packets = 1;
+		if (app->series)
+			series_sent(app->series, app->end.tv_sec, 1);
+		return ;
+	}
+	ahead = seq - target->sequence;
+	if (ahead == 0 || ahead >= 32768)
+		return ;
+	if (app->series)
+		series_sent(app->series, app->end.tv_sec, ahead);
+	// One sequence at a time, as send_echo would have gone through them
+	while (ahead--)
+	{
+		target_next_seq(app, target, target->sequence + 1, app->end);
+		if (app->options[LINGER])
+			deadline_push(app, target);
+		target->sent_packets++;
+		loss_advance(app, target, target->sent_packets
+			- app->settle_lag);
+	}
+}
+
+/**
+ * --replay FILE: every ICMP packet of a pcap capture goes through the live
+ * reply pipeline (packet_parse, process_packet, update_stats), with
+ * its capture timestamp standing for the kernel receive time. The file is
+ * mapped, each packet is copied once into the receive buffer.
+ */
+int	replay_run(t_ft_ping *app)
+{
+	t_replay			replay;
+	const uint8_t		*packet;
+	const t_icmp_header	*icmp;
+	size_t				len;
+	t_target			*target;
+	t_packet			pkt;
+
+	replay_open(&replay, app->replay_path);
+	replay_discover(app, &replay);
+	if (!app->target_count)
+	{
+		fprintf(stderr, "ft_ping: %s: no echo requests\n", app->replay_path);
+		munmap((void *)replay.map, replay.size);
+		return (1);
+	}
+	app->packet_size = 0;
+	while (!app->stop && replay_next(&replay, &packet, &len, &app->end))
+	{
+		if (!timerisset(&app->start))
+			app->start = app->end;
+		if (app->options[TIMEOUT] && elapsed_time(app->start, app->end)
+			>= app->options[TIMEOUT] * 1000000LL)
+			break ;
+		// -W deadlines run on the capture clock
+		if (app->options[LINGER])
+			deadline_expire(app, app->end);
+		icmp = replay_request(packet, len);
+		if (icmp)
+		{
+			target = target_lookup(app, ntohs(icmp->un.echo.id), 0);
+			if (target)
+				replay_sent(app, target, ntohs(icmp->un.echo.sequence),
+					len - ((const t_ip_header *)packet)->ihl * 4);
+			continue ;
+		}
+		if (len > sizeof(app->recvbuffer))
+			continue ;
+		memcpy(app->recvbuffer, packet, len);
+		if (packet_parse(app->recvbuffer, len, &pkt))
+			process_packet(app, &pkt);
+	}
+	munmap((void *)replay.map, replay.size);
+	clean_up();
+	return (0);
+}
@@ -0,0 +1,332 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   resolver.c                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 14:29:49 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 14:29:49 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* FNV-1a, good enough to spread hostnames over the index */
+static size_t	hash_name(const char *name)
+{
+	size_t	hash;
+
+	hash = 2166136261u;
+	while (*name)
+	{
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return (hash);
+}
+
+static void	*resolver_worker(void *arg)
+{
+	t_resolver			*resolver;
+	t_dns_done			done;
+	struct sockaddr_in	addr;
+
+	resolver = arg;
+	pthread_mutex_lock(&resolver->lock);
+	while (1)
+	{
+		while (!resolver->shutdown && resolver->q_len == 0)
+			pthread_cond_wait(&resolver->cond, &resolver->lock);
+		if (resolver->shutdown)
+			break ;
+		done.entry = resolver->queue[resolver->q_head];
+		resolver->q_head = (resolver->q_head + 1) % resolver->nentries;
+		resolver->q_len--;
+		pthread_mutex_unlock(&resolver->lock);
+		// The blocking part runs without the lock
+		memset(&addr, 0, sizeof(addr));
+		done.status = resolv_hostname(resolver->entries[done.entry].name,
+				&addr);
+		done.addr = addr.sin_addr;
+		pthread_mutex_lock(&resolver->lock);
+		resolver->done[(resolver->d_head + resolver->d_len)
+			% resolver->nentries] = done;
+		resolver->d_len++;
+		// A full pipe already guarantees a wake up
+		if (write(resolver->pipefd[1], "", 1) < 0 && errno != EAGAIN)
+			perror("ft_ping: resolver pipe");
+	}
+	pthread_mutex_unlock(&resolver->lock);
+	return (NULL);
+}
+
+static void	resolver_enqueue(t_resolver *resolver, size_t entry)
+{
+	resolver->entries[entry].pending = true;
+	resolver->pending++;
+	pthread_mutex_lock(&resolver->lock);
+	resolver->queue[(resolver->q_head + resolver->q_len)
+		% resolver->nentries] = entry;
+	resolver->q_len++;
+	pthread_cond_signal(&resolver->cond);
+	pthread_mutex_unlock(&resolver->lock);
+}
+
+/* Returns the cache entry for hostname, creating it if needed */
+static size_t	resolver_entry(t_resolver *resolver, const char *hostname)
+{
+	size_t	slot;
+	size_t	entry;
+
+	slot = hash_name(hostname) & resolver->index_mask;
+	while (resolver->index[slot] != SIZE_MAX)
+	{
+		entry = resolver->index[slot];
+		if (strcmp(resolver->entries[entry].name, hostname) == 0)
+			return (entry);
+		slot = (slot + 1) & resolver->index_mask;
+	}
+	entry = resolver->nentries++;
+	resolver->index[slot] = entry;
+	resolver->entries[entry].name = hostname;
+	resolver->entries[entry].first_target = -1;
+	return (entry);
+}
+
+static void	resolver_alloc(t_resolver *resolver, size_t count)
+{
+	size_t	index_size;
+
+	index_size = 1;
+	while (index_size < count * 2)
+		index_size <<= 1;
+	resolver->index_mask = index_size - 1;
+	resolver->index = malloc(index_size * sizeof(*resolver->index));
+	resolver->entries = calloc(count, sizeof(*resolver->entries));
+	resolver->queue = calloc(count, sizeof(*resolver->queue));
+	resolver->done = calloc(count, sizeof(*resolver->done));
+	if (!resolver->index || !resolver->entries || !resolver->queue
+		|| !resolver->done)
+	{
+		perror("ft_ping: resolver");
+		exit(1);
+	}
+	memset(resolver->index, 0xff, index_size * sizeof(*resolver->index));
+}
+
+static void	resolver_spawn(t_resolver *resolver, int nthreads)
+{
+	sigset_t	all, old;
+
+	// Workers must never take SIGINT away from the probe loop
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	while (resolver->nthreads < nthreads)
+	{
+		if (pthread_create(&resolver->threads[resolver->nthreads], NULL,
+				resolver_worker, resolver) != 0)
+			break ;
+		resolver->nthreads++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (resolver->nthreads == 0)
+	{
+		fprintf(stderr, "ft_ping: cannot start resolver threads\n");
+		exit(1);
+	}
+}
+
+/* The cache, with one entry per distinct hostname, and no worker yet */
+static t_resolver	*resolver_new(t_ft_ping *app)
+{
+	t_resolver	*resolver;
+	size_t		i;
+	size_t		entry;
+
+	resolver = calloc(1, sizeof(*resolver));
+	if (!resolver)
+	{
+		perror("ft_ping: resolver");
+		exit(1);
+	}
+	app->resolver = resolver;
+	pthread_mutex_init(&resolver->lock, NULL);
+	pthread_cond_init(&resolver->cond, NULL);
+	resolver->pipefd[0] = resolver->pipefd[1] = -1;
+	if (pipe(resolver->pipefd) < 0)
+	{
+		perror("ft_ping: pipe");
+		exit(1);
+	}
+	fcntl(resolver->pipefd[0], F_SETFL, O_NONBLOCK);
+	fcntl(resolver->pipefd[1], F_SETFL, O_NONBLOCK);
+	resolver_alloc(resolver, app->target_count);
+	// Walk backwards so each alias chain lists targets in command line order
+	for (i = app->target_count; i-- > 0;)
+	{
+		entry = resolver_entry(resolver, app->targets[i].info->hostname);
+		app->targets[i].info->dns_next = resolver->entries[entry].first_target;
+		resolver->entries[entry].first_target = i;
+	}
+	return (resolver);
+}
+
+/**
+ * Resolve all the targets in the background. Hostnames given more than once
+ * share a cache entry and are looked up a single time.
+ */
+void	resolver_start(t_ft_ping *app)
+{
+	t_resolver	*resolver;
+	size_t		entry;
+	int			nthreads;
+
+	resolver = resolver_new(app);
+	for (entry = 0; entry < resolver->nentries; entry++)
+		resolver_enqueue(resolver, entry);
+	nthreads = app->options[RESOLVERS];
+	if ((size_t)nthreads > resolver->nentries)
+		nthreads = resolver->nentries;
+	resolver_spawn(resolver, nthreads);
+}
+
+/* A single HOST, already resolved before the first probe: one worker keeps
+its address fresh every --dns-ttl seconds, as for several hosts */
+void	resolver_watch(t_ft_ping *app)
+{
+	t_resolver	*resolver;
+
+	resolver = resolver_new(app);
+	resolver->entries[0].addr = app->targets[0].dest_addr.sin_addr;
+	resolver->entries[0].expires = monotonic_seconds() + app->options[DNS_TTL];
+	resolver_spawn(resolver, 1);
+}
+
+static void	resolver_update_target(t_ft_ping *app, t_target *target,
+			t_dns_entry *entry)
+{
+	if (target->state == TARGET_RESOLVING && entry->status != 0)
+	{
+		if (entry->status == EAI_NONAME)
+			fprintf(stderr, "ft_ping: %s: unknown host\n", target->info->hostname);
+		else
+			fprintf(stderr, "ft_ping: %s: %s\n", target->info->hostname,
+				gai_strerror(entry->status));
+		target->state = TARGET_FAILED;
+		target_finish(app, target);
+	}
+	else if (target->state == TARGET_RESOLVING)
+	{
+		target_set_address(target, entry->addr);
+		target->state = TARGET_READY;
+		ping_start_target(app, target);
+	}
+	else if (target->state == TARGET_READY && entry->status == 0
+		&& target->dest_addr.sin_addr.s_addr != entry->addr.s_addr)
+	{
+		// Replies still in flight to the old address are matched by echo id
+		target_set_address(target, entry->addr);
+		if (app->options[VERBOSE])
+			printf("%s now resolves to %s\n", target->info->hostname,
+				target->info->ip_str);
+	}
+}
+
+static void	resolver_complete(t_ft_ping *app, t_dns_done *done)
+{
+	t_dns_entry	*entry;
+	int			i;
+
+	entry = &app->resolver->entries[done->entry];
+	entry->pending = false;
+	app->resolver->pending--;
+	entry->status = done->status;
+	entry->expires = monotonic_seconds() + app->options[DNS_TTL];
+	// On a failed refresh keep probing the last good address
+	if (done->status == 0)
+		entry->addr = done->addr;
+	for (i = entry->first_target; i >= 0; i = app->targets[i].info->dns_next)
+		resolver_update_target(app, &app->targets[i], entry);
+}
+
+/* Called when the resolver pipe is readable: hand finished lookups over to
+the probe loop */
+void	resolver_poll(t_ft_ping *app)
+{
+	t_resolver	*resolver;
+	t_dns_done	done;
+	char		drain[256];
+
+	resolver = app->resolver;
+	while (read(resolver->pipefd[0], drain, sizeof(drain)) > 0)
+		;
+	while (1)
+	{
+		pthread_mutex_lock(&resolver->lock);
+		if (resolver->d_len == 0)
+		{
+			pthread_mutex_unlock(&resolver->lock);
+			break ;
+		}
+		done = resolver->done[resolver->d_head];
+		resolver->d_head = (resolver->d_head + 1) % resolver->nentries;
+		resolver->d_len--;
+		pthread_mutex_unlock(&resolver->lock);
+		resolver_complete(app, &done);
+	}
+}
+
+/* Re-resolve expired hostnames at most once per second. Targets keep their
+current address until the new answer arrives. */
+void	resolver_refresh(t_ft_ping *app)
+{
+	t_resolver	*resolver;
+	t_dns_entry	*entry;
+	time_t		now;
+	size_t		i;
+
+	resolver = app->resolver;
+	now = monotonic_seconds();
+	if (now < resolver->next_refresh)
+		return ;
+	resolver->next_refresh = now + 1;
+	for (i = 0; i < resolver->nentries; i++)
+	{
+		entry = &resolver->entries[i];
+		if (entry->pending || !entry->expires || entry->expires > now)
+			continue ;
+		if (app->targets[entry->first_target].state == TARGET_READY)
+			resolver_enqueue(resolver, i);
+	}
+}
+
+int	resolver_fd(t_resolver *resolver)
+{
+	return (resolver->pipefd[0]);
+}
+
+void	resolver_destroy(t_resolver *resolver)
+{
+	int	i;
+
+	pthread_mutex_lock(&resolver->lock);
+	resolver->shutdown = true;
+	pthread_cond_broadcast(&resolver->cond);
+	pthread_mutex_unlock(&resolver->lock);
+	// A worker stuck in getaddrinfo finishes its lookup before exiting
+	for (i = 0; i < resolver->nthreads; i++)
+		pthread_join(resolver->threads[i], NULL);
+	if (resolver->pipefd[0] >= 0)
+		close(resolver->pipefd[0]);
+	if (resolver->pipefd[1] >= 0)
+		close(resolver->pipefd[1]);
+	pthread_mutex_destroy(&resolver->lock);
+	pthread_cond_destroy(&resolver->cond);
+	free(resolver->index);
+	free(resolver->entries);
+	free(resolver->queue);
+	free(resolver->done);
+	free(resolver);
+}
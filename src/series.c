@@ -0,0 +1,178 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   series.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 12:35:54 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 12:35:54 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/**
+ * Latency over time in three tiers of fixed rings: per second, per minute
+ * and per hour. Every probe and reply goes into the open slot of each
+ * tier, so a minute slot is exactly the merge of its seconds; once a ring
+ * is full its oldest slot is reused, and memory stays at
+ * sizeof(t_series) whatever the run length.
+ */
+void	series_init(t_ft_ping *app)
+{
+	static const int	seconds[SERIES_TIERS] = {1, 60, 3600};
+	static const int	sizes[SERIES_TIERS] = {SERIES_SECONDS, SERIES_MINUTES,
+		SERIES_HOURS};
+	t_series			*series;
+	t_series_slot		*slots;
+	int					i;
+
+	series = calloc(1, sizeof(*series));
+	if (!series)
+	{
+		perror("ft_ping: calloc");
+		exit(1);
+	}
+	slots = series->slots;
+	for (i = 0; i < SERIES_TIERS; i++)
+	{
+		series->tiers[i].seconds = seconds[i];
+		series->tiers[i].size = sizes[i];
+		series->tiers[i].slots = slots;
+		slots += sizes[i];
+	}
+	app->series = series;
+}
+
+/* The open slot of a tier for time `now`, opening the next one when the
+clock moved past it. A clock going back keeps the current slot */
+static t_series_slot	*series_slot(t_series_tier *tier, time_t now)
+{
+	t_series_slot	*slot;
+	time_t			start;
+
+	start = now - now % tier->seconds;
+	slot = &tier->slots[tier->head];
+	if (tier->count && start <= slot->start)
+		return (slot);
+	if (tier->count)
+		tier->head = (tier->head + 1) % tier->size;
+	if (tier->count < tier->size)
+		tier->count++;
+	slot = &tier->slots[tier->head];
+	memset(slot, 0, sizeof(*slot));
+	slot->start = start;
+	return (slot);
+}
+
+void	series_sent(t_series *series, time_t now, int count)
+{
+	int	i;
+
+	for (i = 0; i < SERIES_TIERS; i++)
+		series_slot(&series->tiers[i], now)->sent += count;
+}
+
+/* Log buckets of ratio SERIES_GAMMA from 1 us, like the RTT sketch */
+void	series_reply(t_series *series, time_t now, long long usec)
+{
+	t_series_slot	*slot;
+	int				key;
+	int				i;
+
+	key = 0;
+	if (usec > 1)
+		key = (int)ceil(log((double)usec) / log(SERIES_GAMMA));
+	if (key >= SERIES_BINS)
+		key = SERIES_BINS - 1;
+	for (i = 0; i < SERIES_TIERS; i++)
+	{
+		slot = series_slot(&series->tiers[i], now);
+		if (!slot->received || usec < slot->min)
+			slot->min = usec;
+		if (!slot->received || usec > slot->max)
+			slot->max = usec;
+		slot->sum += usec;
+		slot->received++;
+		slot->bins[key]++;
+	}
+}
+
+/* Quantile q of a slot in ms, from the middle of its bucket */
+static double	series_quantile(const t_series_slot *slot, double q)
+{
+	uint32_t	rank;
+	uint32_t	seen;
+	int			i;
+
+	rank = (uint32_t)(q * (slot->received - 1));
+	seen = 0;
+	for (i = 0; i < SERIES_BINS - 1; i++)
+	{
+		seen += slot->bins[i];
+		if (rank < seen)
+			break ;
+	}
+	return (2 * pow(SERIES_GAMMA, i) / (SERIES_GAMMA + 1) / 1000);
+}
+
+/*
+Example:
+second 2026-10-19T14:02:07    10    10   0.0  0.041  0.052  0.066  0.052  0.063  0.063
+*/
+static void	series_print_slot(FILE *file, const char *name,
+		const t_series_slot *slot)
+{
+	char		date[32];
+	struct tm	tm;
+
+	localtime_r(&slot->start, &tm);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+	fprintf(file, "%-6s %s %5u %5u", name, date, slot->sent, slot->received);
+	if (slot->sent > slot->received)
+		fprintf(file, " %5.1f", 100.0 * (slot->sent - slot->received)
+			/ slot->sent);
+	else
+		fprintf(file, " %5.1f", 0.0);
+	if (!slot->received)
+	{
+		fprintf(file, "\n");
+		return ;
+	}
+	fprintf(file, " %6.3f %6.3f %6.3f %6.3f %6.3f %6.3f\n",
+		slot->min / 1000.0, (double)slot->sum / slot->received / 1000,
+		slot->max / 1000.0, series_quantile(slot, 0.50),
+		series_quantile(slot, 0.90), series_quantile(slot, 0.99));
+}
+
+/**
+ * Writes every tier, oldest slot first, over --series FILE. Called at exit
+ * and on SIGUSR1, so a long run can be looked at while it goes on.
+ */
+void	series_dump(t_ft_ping *app)
+{
+	static const char	*names[SERIES_TIERS] = {"second", "minute", "hour"};
+	t_series_tier		*tier;
+	FILE				*file;
+	int					i;
+	int					j;
+
+	file = fopen(app->series_path, "w");
+	if (!file)
+	{
+		fprintf(stderr, "ft_ping: %s: %s\n", app->series_path, strerror(errno));
+		return ;
+	}
+	fprintf(file, "# tier  start               sent  rcvd loss%%"
+		"    min    avg    max    p50    p90    p99 (ms)\n");
+	for (i = SERIES_TIERS - 1; i >= 0; i--)
+	{
+		tier = &app->series->tiers[i];
+		for (j = tier->count - 1; j >= 0; j--)
+			series_print_slot(file, names[i], &tier->slots[
+				(tier->head - j + tier->size) % tier->size]);
+	}
+	fclose(file);
+}
@@ -0,0 +1,314 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   simnet.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 09:33:42 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 09:33:42 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* xorshift64*: fast, and reproducible with seed= */
+static double	sim_random(t_simnet *sim)
+{
+	sim->rng ^= sim->rng >> 12;
+	sim->rng ^= sim->rng << 25;
+	sim->rng ^= sim->rng >> 27;
+	return (((sim->rng * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53);
+}
+
+static bool	sim_before(const t_sim_packet *a, const t_sim_packet *b)
+{
+	if (timercmp(&a->due, &b->due, !=))
+		return (timercmp(&a->due, &b->due, <));
+	return (a->order < b->order);
+}
+
+static void	sim_swap(t_sim_packet *a, t_sim_packet *b)
+{
+	t_sim_packet	tmp;
+
+	tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+/* Min-heap on due time, FIFO among packets due at the same time */
+static void	sim_push(t_simnet *sim, t_sim_packet *packet)
+{
+	t_sim_packet	*heap;
+	size_t			i;
+
+	if (sim->len == sim->cap)
+	{
+		sim->cap = sim->cap ? sim->cap * 2 : 64;
+		heap = realloc(sim->heap, sim->cap * sizeof(*heap));
+		if (!heap)
+		{
+			perror("ft_ping: simulate");
+			exit(1);
+		}
+		sim->heap = heap;
+	}
+	packet->order = sim->order++;
+	i = sim->len++;
+	sim->heap[i] = *packet;
+	while (i && sim_before(&sim->heap[i], &sim->heap[(i - 1) / 2]))
+	{
+		sim_swap(&sim->heap[i], &sim->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+}
+
+static void	sim_pop(t_simnet *sim)
+{
+	size_t	i;
+	size_t	child;
+
+	sim->heap[0] = sim->heap[--sim->len];
+	i = 0;
+	while ((child = 2 * i + 1) < sim->len)
+	{
+		if (child + 1 < sim->len
+			&& sim_before(&sim->heap[child + 1], &sim->heap[child]))
+			child++;
+		if (!sim_before(&sim->heap[child], &sim->heap[i]))
+			break ;
+		sim_swap(&sim->heap[i], &sim->heap[child]);
+		i = child;
+	}
+}
+
+/* One copy of the reply, delivered after delay + jitter (+ a hold back when
+it is picked to be reordered) */
+static void	sim_schedule(t_simnet *sim, const uint8_t *reply, size_t len,
+		in_addr_t from)
+{
+	t_sim_packet	packet;
+	long long		delay;
+
+	delay = sim->delay_us + sim_random(sim) * sim->jitter_us;
+	if (sim->reorder > 0 && sim_random(sim) * 100 < sim->reorder)
+	{
+		delay += sim->delay_us + sim->jitter_us + 1000;
+		sim->reordered++;
+	}
+	clock_now(&packet.due);
+	packet.due.tv_sec += delay / 1000000;
+	packet.due.tv_usec += delay % 1000000;
+	normalize_timeval(&packet.due);
+	packet.from = from;
+	packet.len = len;
+	packet.data = malloc(len);
+	if (!packet.data)
+	{
+		perror("ft_ping: simulate");
+		exit(1);
+	}
+	memcpy(packet.data, reply, len);
+	sim_push(sim, &packet);
+}
+
+/* Every destination answers its echo requests; anything else is swallowed */
+static int	sim_send(t_transport *transport, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *addr, int ttl)
+{
+	t_simnet		*sim;
+	uint8_t			reply[IP_MAXPACKET];
+	t_ip_header		*ip;
+	t_icmp_header	*icmp;
+
+	(void)ttl;
+	sim = transport->ctx;
+	sim->sent++;
+	if (len < ICMP_HEADER_SIZE || len > IP_MAXPACKET - sizeof(t_ip_header)
+		|| ((const t_icmp_header *)buf)->type != ICMP_ECHO)
+		return (len);
+	if (sim->loss > 0 && sim_random(sim) * 100 < sim->loss)
+	{
+		sim->dropped++;
+		return (len);
+	}
+	ip = (t_ip_header *)reply;
+	memset(ip, 0, sizeof(*ip));
+	ip->version = 4;
+	ip->ihl = 5;
+	ip->ttl = 64;
+	ip->protocol = IPPROTO_ICMP;
+	ip->tot_len = htons(sizeof(*ip) + len);
+	ip->saddr = addr->sin_addr.s_addr;
+	ip->daddr = htonl(INADDR_LOOPBACK);
+	ip->check = calculate_checksum((uint16_t *)ip, sizeof(*ip));
+	icmp = (t_icmp_header *)(reply + sizeof(*ip));
+	memcpy(icmp, buf, len);
+	icmp->type = ICMP_ECHOREPLY;
+	if (sim->corrupt > 0 && len > ICMP_HEADER_SIZE
+		&& sim_random(sim) * 100 < sim->corrupt)
+	{
+		((uint8_t *)icmp)[ICMP_HEADER_SIZE + (size_t)(sim_random(sim)
+				* (len - ICMP_HEADER_SIZE))] ^= 0x01;
+		sim->corrupted++;
+	}
+	icmp->checksum = 0;
+	icmp->checksum = calculate_checksum((uint16_t *)icmp, len);
+	sim_schedule(sim, reply, sizeof(*ip) + len, ip->saddr);
+	if (sim->dup > 0 && sim_random(sim) * 100 < sim->dup)
+	{
+		sim_schedule(sim, reply, sizeof(*ip) + len, ip->saddr);
+		sim->duplicated++;
+	}
+	return (len);
+}
+
+/* Earliest packet already due, -1 with EAGAIN when none is */
+static int	sim_recv(t_transport *transport, uint8_t *buf, size_t size,
+		struct sockaddr_in *from, struct timeval *stamp)
+{
+	t_simnet		*sim;
+	t_sim_packet	*packet;
+	struct timeval	now;
+	size_t			len;
+
+	sim = transport->ctx;
+	clock_now(&now);
+	if (!sim->len || timercmp(&sim->heap[0].due, &now, >))
+	{
+		errno = EAGAIN;
+		return (-1);
+	}
+	packet = &sim->heap[0];
+	len = packet->len < size ? packet->len : size;
+	memcpy(buf, packet->data, len);
+	memset(from, 0, sizeof(*from));
+	from->sin_family = AF_INET;
+	from->sin_addr.s_addr = packet->from;
+	if (stamp)
+		*stamp = packet->due;	// arrival "on the wire", like SO_TIMESTAMP
+	free(packet->data);
+	sim_pop(sim);
+	return (len);
+}
+
+static bool	sim_next_event(t_transport *transport, struct timeval *delay)
+{
+	t_simnet		*sim;
+	struct timeval	now;
+
+	sim = transport->ctx;
+	if (!sim->len)
+		return (false);
+	clock_now(&now);
+	if (timercmp(&sim->heap[0].due, &now, <=))
+		timerclear(delay);
+	else
+		timersub(&sim->heap[0].due, &now, delay);
+	return (true);
+}
+
+static void	sim_close(t_transport *transport)
+{
+	t_simnet	*sim;
+
+	sim = transport->ctx;
+	if (!sim)
+		return ;
+	while (sim->len)
+	{
+		free(sim->heap[0].data);
+		sim_pop(sim);
+	}
+	free(sim->heap);
+	free(sim);
+	transport->ctx = NULL;
+}
+
+static void	sim_parse(t_simnet *sim, const char *spec)
+{
+	char	buf[256];
+	char	*item;
+	char	*value;
+	char	*save;
+	char	*endptr;
+	double	number;
+
+	if (strlen(spec) >= sizeof(buf))
+	{
+		fprintf(stderr, "ft_ping: --simulate settings too long\n");
+		exit(1);
+	}
+	strcpy(buf, spec);
+	for (item = strtok_r(buf, ",", &save); item;
+		item = strtok_r(NULL, ",", &save))
+	{
+		value = strchr(item, '=');
+		if (value)
+			*value++ = '\0';
+		number = value ? strtod(value, &endptr) : -1;
+		if (!value || endptr == value || *endptr || number < 0)
+		{
+			fprintf(stderr, "ft_ping: invalid --simulate setting '%s'\n", item);
+			exit(1);
+		}
+		if (!strcmp(item, "delay"))
+			sim->delay_us = number * 1000;
+		else if (!strcmp(item, "jitter"))
+			sim->jitter_us = number * 1000;
+		else if (!strcmp(item, "loss") && number <= 100)
+			sim->loss = number;
+		else if (!strcmp(item, "dup") && number <= 100)
+			sim->dup = number;
+		else if (!strcmp(item, "reorder") && number <= 100)
+			sim->reorder = number;
+		else if (!strcmp(item, "corrupt") && number <= 100)
+			sim->corrupt = number;
+		else if (!strcmp(item, "seed"))
+			sim->rng = (uint64_t)number;
+		else
+		{
+			fprintf(stderr, "ft_ping: invalid --simulate setting '%s'\n", item);
+			exit(1);
+		}
+	}
+}
+
+/**
+ * In-memory network: every echo request is answered by its destination
+ * after delay + jitter (milliseconds), with loss, dup, reorder and corrupt
+ * (one payload byte flipped, checksum fixed like a rewriting middlebox)
+ * given in percent, e.g. "delay=5,jitter=1,loss=2,dup=0.5,reorder=1,seed=42".
+ * No socket and no privileges involved. Under the virtual clock the default
+ * seed only depends on the clock, so runs repeat.
+ */
+void	simnet_init(t_transport *transport, const char *spec,
+		bool virtual_clock)
+{
+	t_simnet		*sim;
+	struct timeval	now;
+
+	sim = calloc(1, sizeof(t_simnet));
+	if (!sim)
+	{
+		perror("ft_ping: simulate");
+		exit(1);
+	}
+	clock_now(&now);
+	sim->rng = now.tv_sec ^ now.tv_usec;
+	if (!virtual_clock)
+		sim->rng ^= getpid();
+	sim_parse(sim, spec);
+	if (!sim->rng)
+		sim->rng = 1;	// xorshift never leaves 0
+	memset(transport, 0, sizeof(*transport));
+	transport->name = "simulated";
+	transport->fd = -1;
+	transport->ctx = sim;
+	transport->send = sim_send;
+	transport->recv = sim_recv;
+	transport->next_event = sim_next_event;
+	transport->close = sim_close;
+}
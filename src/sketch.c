@@ -0,0 +1,267 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sketch.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 09:27:35 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 09:27:35 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/**
+ * DDSketch (Masson et al., 2019) over RTTs in microseconds: bucket k holds
+ * values in (gamma^(k-1), gamma^k] with gamma = (1 + a) / (1 - a), so any
+ * quantile comes back within a relative error a = SKETCH_ALPHA. Buckets
+ * start at 1 us and SKETCH_BINS of them reach past 100 s; anything above
+ * lands in the last one. Two sketches merge by adding their counts.
+ */
+static double	sketch_gamma_log(void)
+{
+	static double	gamma_log;
+
+	if (gamma_log == 0)
+		gamma_log = log((1 + SKETCH_ALPHA) / (1 - SKETCH_ALPHA));
+	return (gamma_log);
+}
+
+void	sketch_add(t_sketch *sketch, long long usec)
+{
+	int	key;
+
+	if (!sketch->count++ || usec < sketch->min)
+		sketch->min = usec;
+	if (sketch->count == 1 || usec > sketch->max)
+		sketch->max = usec;
+	if (usec < 1)
+	{
+		sketch->zero++;
+		return ;
+	}
+	key = (int)ceil(log((double)usec) / sketch_gamma_log());
+	if (key >= SKETCH_BINS)
+		key = SKETCH_BINS - 1;
+	sketch->bins[key]++;
+}
+
+void	sketch_merge(t_sketch *dst, const t_sketch *src)
+{
+	int	i;
+
+	if (!src->count)
+		return ;
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (!dst->count || src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->zero += src->zero;
+	for (i = 0; i < SKETCH_BINS; i++)
+		dst->bins[i] += src->bins[i];
+}
+
+/* Value of quantile q in [0, 1], in microseconds (0 for an empty sketch),
+clamped to [min, max]: a bucket's middle may lie past the values in it */
+double	sketch_quantile(const t_sketch *sketch, double q)
+{
+	uint64_t	rank;
+	uint64_t	seen;
+	double		value;
+	int			i;
+
+	if (!sketch->count)
+		return (0);
+	rank = (uint64_t)(q * (sketch->count - 1));
+	seen = sketch->zero;
+	value = 0;
+	if (rank >= seen)
+	{
+		for (i = 0; i < SKETCH_BINS; i++)
+		{
+			seen += sketch->bins[i];
+			if (rank < seen)
+				break ;
+		}
+		if (i == SKETCH_BINS)
+			i = SKETCH_BINS - 1;
+		// Middle of the bucket in relative terms: 2 gamma^k / (gamma + 1)
+		value = 2 * exp(i * sketch_gamma_log())
+			/ (exp(sketch_gamma_log()) + 1);
+	}
+	if (value < sketch->min)
+		value = sketch->min;
+	if (value > sketch->max)
+		value = sketch->max;
+	return (value);
+}
+
+/* Example: round-trip p50/p90/p99/p99.9 = 0.051/0.062/0.110/0.212 ms */
+void	sketch_print(const t_sketch *sketch)
+{
+	printf("round-trip p50/p90/p99/p99.9 = %.3f/%.3f/%.3f/%.3f ms\n",
+		sketch_quantile(sketch, 0.50) / 1000,
+		sketch_quantile(sketch, 0.90) / 1000,
+		sketch_quantile(sketch, 0.99) / 1000,
+		sketch_quantile(sketch, 0.999) / 1000);
+}
+
+/**
+ * One line per sketch, sparse:
+ * "ddsketch 2 ALPHA NAME COUNT ZERO MIN MAX k:n ..."
+ * Lines of any number of runs can be concatenated and merged later.
+ */
+void	sketch_save(FILE *file, const char *name, const t_sketch *sketch)
+{
+	int	i;
+
+	fprintf(file, "ddsketch %d %g %s %llu %llu %lld %lld", SKETCH_VERSION,
+		SKETCH_ALPHA, name, (unsigned long long)sketch->count,
+		(unsigned long long)sketch->zero, sketch->min, sketch->max);
+	for (i = 0; i < SKETCH_BINS; i++)
+	{
+		if (sketch->bins[i])
+			fprintf(file, " %d:%u", i, sketch->bins[i]);
+	}
+	fprintf(file, "\n");
+}
+
+/* --save-sketch: every target's sketch, written at exit */
+void	sketch_save_targets(t_ft_ping *app)
+{
+	FILE	*file;
+	size_t	i;
+
+	file = fopen(app->sketch_path, "w");
+	if (!file)
+	{
+		fprintf(stderr, "ft_ping: %s: %s\n", app->sketch_path, strerror(errno));
+		return ;
+	}
+	for (i = 0; i < app->target_count; i++)
+	{
+		if (app->targets[i].sketch->count)
+			sketch_save(file, app->targets[i].info->ip_str,
+				app->targets[i].sketch);
+	}
+	fclose(file);
+}
+
+/* Parses one saved line into name/sketch, false if it isn't one of ours */
+static bool	sketch_parse(char *line, char *name, size_t name_size,
+		t_sketch *sketch)
+{
+	int					version;
+	double				alpha;
+	unsigned long long	count;
+	unsigned long long	zero;
+	long long			min;
+	long long			max;
+	int					used;
+	char				*p;
+	int					key;
+	unsigned int		n;
+	char				fmt[64];
+
+	snprintf(fmt, sizeof(fmt),
+		"ddsketch %%d %%lf %%%zus %%llu %%llu %%lld %%lld%%n", name_size - 1);
+	if (sscanf(line, fmt, &version, &alpha, name, &count, &zero, &min, &max,
+			&used) != 7 || version != SKETCH_VERSION || fabs(alpha - SKETCH_ALPHA) > 1e-9)
+		return (false);
+	memset(sketch, 0, sizeof(*sketch));
+	sketch->count = count;
+	sketch->zero = zero;
+	sketch->min = min;
+	sketch->max = max;
+	for (p = line + used; sscanf(p, " %d:%u%n", &key, &n, &used) == 2;
+		p += used)
+	{
+		if (key < 0 || key >= SKETCH_BINS)
+			return (false);
+		sketch->bins[key] += n;
+	}
+	return (true);
+}
+
+static t_sketch_entry	*sketch_find(t_sketch_entry **entries, size_t *len,
+		const char *name)
+{
+	t_sketch_entry	*grown;
+	size_t			i;
+
+	for (i = 0; i < *len; i++)
+	{
+		if (!strcmp((*entries)[i].name, name))
+			return (&(*entries)[i]);
+	}
+	grown = realloc(*entries, (*len + 1) * sizeof(**entries));
+	if (!grown)
+	{
+		perror("ft_ping: merge");
+		exit(1);
+	}
+	*entries = grown;
+	memset(&grown[*len], 0, sizeof(grown[*len]));
+	snprintf(grown[*len].name, sizeof(grown[*len].name), "%s", name);
+	return (&grown[(*len)++]);
+}
+
+static void	sketch_print_row(const char *name, const t_sketch *sketch)
+{
+	printf("%-24s %10llu %9.3f %9.3f %9.3f %9.3f\n", name,
+		(unsigned long long)sketch->count,
+		sketch_quantile(sketch, 0.50) / 1000,
+		sketch_quantile(sketch, 0.90) / 1000,
+		sketch_quantile(sketch, 0.99) / 1000,
+		sketch_quantile(sketch, 0.999) / 1000);
+}
+
+/**
+ * --merge-sketch FILE...: adds up the saved sketches of any number of runs,
+ * per target and fleet wide, and prints their percentiles.
+ */
+int	sketch_merge_files(char **paths, int count)
+{
+	t_sketch_entry	*entries;
+	size_t			len;
+	t_sketch		sketch;
+	t_sketch		*all;
+	char			name[ADDR_TEXT_SIZE];
+	char			line[SKETCH_LINE_SIZE];
+	FILE			*file;
+	int				i;
+
+	entries = NULL;
+	len = 0;
+	all = calloc(1, sizeof(*all));
+	if (!all)
+		return (1);
+	for (i = 0; i < count; i++)
+	{
+		file = fopen(paths[i], "r");
+		if (!file)
+		{
+			fprintf(stderr, "ft_ping: %s: %s\n", paths[i], strerror(errno));
+			continue ;
+		}
+		while (fgets(line, sizeof(line), file))
+		{
+			if (!sketch_parse(line, name, sizeof(name), &sketch))
+				continue ;
+			sketch_merge(&sketch_find(&entries, &len, name)->sketch, &sketch);
+			sketch_merge(all, &sketch);
+		}
+		fclose(file);
+	}
+	printf("%-24s %10s %9s %9s %9s %9s\n", "TARGET", "REPLIES", "P50", "P90",
+		"P99", "P99.9");
+	for (i = 0; i < (int)len; i++)
+		sketch_print_row(entries[i].name, &entries[i].sketch);
+	sketch_print_row("all", all);
+	free(entries);
+	free(all);
+	return (len ? 0 : 1);
+}
@@ -0,0 +1,316 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sweep.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 09:49:03 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 09:49:03 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+static uint64_t	mulmod(uint64_t a, uint64_t b, uint64_t m)
+{
+	return ((a * b) % m); // operands stay below 2^25, no overflow
+}
+
+static uint64_t	powmod(uint64_t base, uint64_t exp, uint64_t m)
+{
+	uint64_t	result;
+
+	result = 1;
+	base %= m;
+	while (exp)
+	{
+		if (exp & 1)
+			result = mulmod(result, base, m);
+		base = mulmod(base, base, m);
+		exp >>= 1;
+	}
+	return (result);
+}
+
+static bool	is_prime(uint64_t n)
+{
+	uint64_t	d;
+
+	if (n < 2)
+		return (false);
+	for (d = 2; d * d <= n; d++)
+	{
+		if (n % d == 0)
+			return (false);
+	}
+	return (true);
+}
+
+/**
+ * Random primitive root of prime p: g generates the whole multiplicative
+ * group iff g^((p-1)/q) != 1 for every prime factor q of p - 1.
+ */
+static uint64_t	primitive_root(uint64_t p)
+{
+	uint64_t	factors[32];
+	uint64_t	n, d, g;
+	int			count, i;
+
+	if (p == 2)
+		return (1);
+	count = 0;
+	n = p - 1;
+	for (d = 2; d * d <= n; d++)
+	{
+		if (n % d)
+			continue ;
+		factors[count++] = d;
+		while (n % d == 0)
+			n /= d;
+	}
+	if (n > 1)
+		factors[count++] = n;
+	while (1)
+	{
+		g = 2 + random() % (p - 2);
+		for (i = 0; i < count && powmod(g, (p - 1) / factors[i], p) != 1; i++)
+			;
+		if (i == count)
+			return (g);
+	}
+}
+
+/* Replies come back at --rate: leave room for about a second of them
+(skb overhead included), or bursts from a dense range get dropped */
+void	sweep_set_socket_options(int raw_socket)
+{
+	int	rcvbuf;
+
+	rcvbuf = g_ft_ping->options[RATE] * 1024;
+	if (setsockopt(raw_socket, SOL_SOCKET, SO_RCVBUFFORCE,
+			&rcvbuf, sizeof(rcvbuf)) != 0)
+		setsockopt(raw_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+}
+
+/* Returns true when hostname is a CIDR range (a.b.c.d/nn) */
+bool	sweep_is_range(const char *hostname)
+{
+	return (strchr(hostname, '/') != NULL);
+}
+
+static void	sweep_parse(t_sweep *sweep, const char *cidr)
+{
+	char			addr[INET_ADDRSTRLEN];
+	const char		*slash;
+	char			*endptr;
+	long			prefix;
+	struct in_addr	in;
+
+	slash = strchr(cidr, '/');
+	prefix = strtol(slash + 1, &endptr, 10);
+	if ((size_t)(slash - cidr) >= sizeof(addr) || *endptr || endptr == slash + 1
+		|| prefix < SWEEP_MIN_PREFIX || prefix > 32)
+	{
+		fprintf(stderr, "ft_ping: invalid range %s (prefix /%d to /32)\n",
+			cidr, SWEEP_MIN_PREFIX);
+		exit(1);
+	}
+	memcpy(addr, cidr, slash - cidr);
+	addr[slash - cidr] = '\0';
+	if (inet_pton(AF_INET, addr, &in) != 1)
+	{
+		fprintf(stderr, "ft_ping: invalid range %s\n", cidr);
+		exit(1);
+	}
+	sweep->size = 1u << (32 - prefix);
+	sweep->base = ntohl(in.s_addr) & ~(sweep->size - 1);
+}
+
+/**
+ * Addresses are visited in the order of the cyclic group Z*_p, with p the
+ * smallest prime above the range size: x -> x * g mod p walks 1..p-1 once,
+ * jumping all over the range, and values past the range are skipped.
+ * No address list is ever built; one bit per address records replies.
+ */
+void	sweep_init(t_ft_ping *app)
+{
+	t_sweep			*sweep;
+	struct timeval	seed;
+
+	sweep = calloc(1, sizeof(t_sweep));
+	if (!sweep)
+	{
+		perror("ft_ping: sweep");
+		exit(1);
+	}
+	app->sweep = sweep;
+	sweep_parse(sweep, app->hostnames[0]);
+	sweep->replied = calloc((sweep->size + 7) / 8, 1);
+	sweep->probes = malloc(SWEEP_PROBES * sizeof(t_sweep_probe));
+	if (!sweep->replied || !sweep->probes)
+	{
+		perror("ft_ping: sweep");
+		exit(1);
+	}
+	memset(sweep->probes, 0xff, SWEEP_PROBES * sizeof(t_sweep_probe));
+	gettimeofday(&seed, NULL);
+	srandom(seed.tv_usec ^ seed.tv_sec ^ app->pid);
+	sweep->prime = sweep->size + 1;
+	while (!is_prime(sweep->prime))
+		sweep->prime++;
+	sweep->generator = primitive_root(sweep->prime);
+	sweep->current = 1 + random() % (sweep->prime - 1);
+}
+
+/* Next address index of the permutation, false once all were visited */
+static bool	sweep_next(t_sweep *sweep, uint32_t *index)
+{
+	while (sweep->steps < sweep->prime - 1)
+	{
+		sweep->current = mulmod(sweep->current, sweep->generator, sweep->prime);
+		sweep->steps++;
+		if (sweep->current <= sweep->size)
+		{
+			*index = sweep->current - 1;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+/**
+ * False when the kernel is out of buffers (ENOBUFS, neighbour queues full):
+ * the same address is retried on the next tick. Any other failure (no route,
+ * broadcast refused...) counts the address as probed.
+ */
+static bool	sweep_send(t_ft_ping *app, uint32_t index)
+{
+	t_target			*target;
+	t_sweep_probe		*probe;
+	struct sockaddr_in	addr;
+	struct timeval		sent;
+	char				payload[app->packet_size - ICMP_HEADER_SIZE];
+
+	target = &app->targets[0];
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(app->sweep->base + index);
+	prepare_payload(payload, sizeof(payload), &sent);
+	target->sequence = (uint16_t)app->sweep->probed;
+	// Kept locally: the stamp echoed back is the remote host's to change
+	probe = &app->sweep->probes[target->sequence];
+	probe->index = index;
+	probe->sent = elapsed_time(app->sweep->start, sent);
+	prepare_echo_request_packet(payload, app->sendbuffer, target->sequence,
+		target->id);
+	if (app->transport.send(&app->transport, app->sendbuffer,
+			app->packet_size, &addr, 0) < 0)
+	{
+		if (errno == ENOBUFS || errno == EAGAIN)
+			return (false);
+		if (app->options[VERBOSE])
+			fprintf(stderr, "ft_ping: sending to %s: %s\n",
+				inet_ntoa(addr.sin_addr), strerror(errno));
+	}
+	app->sweep->probed++;
+	target->sent_packets++;
+	return (true);
+}
+
+void	sweep_start(t_ft_ping *app, t_target *target)
+{
+	printf("SWEEP %s: %u addresses at %d pps, %ld data bytes\n",
+		target->info->hostname, app->sweep->size, app->options[RATE],
+		app->packet_size - ICMP_HEADER_SIZE);
+	clock_now(&app->sweep->start);
+	sweep_tick(app);
+}
+
+/**
+ * Called on every loop tick: send whatever the rate allows since the start,
+ * then linger for late replies once the whole range went out.
+ */
+void	sweep_tick(t_ft_ping *app)
+{
+	t_sweep			*sweep;
+	struct timeval	now;
+	uint64_t		due;
+
+	sweep = app->sweep;
+	clock_now(&now);
+	if (sweep->finished.tv_sec)
+	{
+		if (elapsed_time(sweep->finished, now) >= SWEEP_LINGER_MS * 1000LL)
+			app->stop = 1;
+		return ;
+	}
+	due = (uint64_t)app->options[RATE] * elapsed_time(sweep->start, now)
+		/ 1000000 + 1;
+	while (sweep->probed < due)
+	{
+		if (!sweep->has_next && !sweep_next(sweep, &sweep->next))
+		{
+			sweep->finished = now;
+			return ;
+		}
+		sweep->has_next = true;
+		if (!sweep_send(app, sweep->next))
+			return ;
+		sweep->has_next = false;
+	}
+}
+
+/* Only the first reply of each address in the range is printed, without
+a time when its probe was overwritten SWEEP_PROBES probes later */
+void	sweep_process(t_ft_ping *app, const t_packet *pkt)
+{
+	t_sweep			*sweep;
+	t_sweep_probe	*probe;
+	uint32_t		index;
+	long long		time;
+
+	sweep = app->sweep;
+	if (pkt->type != ICMP_ECHOREPLY || pkt->id != app->targets[0].id)
+		return ;
+	index = ntohl(pkt->ip->saddr) - sweep->base;
+	if (index >= sweep->size || bitmap_test(sweep->replied, index))
+		return ;
+	bitmap_set(sweep->replied, index);
+	sweep->responders++;
+	app->targets[0].rcv_packets++;
+	probe = &sweep->probes[pkt->seq];
+	time = -1;
+	if (probe->index == index)
+		time = (uint32_t)(elapsed_time(sweep->start, app->end) - probe->sent);
+	print_echo(pkt->len, pkt->ip, pkt->seq, time, 0);
+}
+
+/*
+Example:
+--- 10.0.0.0/16 sweep statistics ---
+65536 addresses probed, 12 responded (0.0%), 66.5 s
+*/
+void	sweep_report(t_ft_ping *app)
+{
+	t_sweep			*sweep;
+	struct timeval	now;
+	long long		elapsed;
+
+	sweep = app->sweep;
+	clock_now(&now);
+	elapsed = elapsed_time(sweep->start, now);
+	printf("--- %s sweep statistics ---\n", app->targets[0].info->hostname);
+	printf("%u addresses probed, %u responded (%.1f%%), %lld.%lld s\n",
+		sweep->probed, sweep->responders,
+		sweep->probed ? 100.0 * sweep->responders / sweep->probed : 0.0,
+		elapsed / 1000000, elapsed / 100000 % 10);
+}
+
+void	sweep_destroy(t_sweep *sweep)
+{
+	free(sweep->replied);
+	free(sweep->probes);
+	free(sweep);
+}
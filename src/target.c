@@ -0,0 +1,175 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   target.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 12:48:58 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 12:48:58 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* Round up to a cache line, as arena_alloc does */
+static size_t	arena_size(size_t size)
+{
+	return ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+}
+
+/**
+ * The dup window only has to cover the probes that can still be answered:
+ * LOSS_WINDOW, or a whole preload or flood window, are settled that far
+ * behind the sender.
+ * Twice that as a power of two, since a sequence reuses the bit of
+ * sequence - window, up to the whole 16 bit sequence space.
+ */
+static void	targets_dup_window(t_ft_ping *app)
+{
+	uint32_t	outstanding;
+
+	outstanding = LOSS_WINDOW;
+	if (app->options[PRELOAD] > outstanding)
+		outstanding = app->options[PRELOAD];
+	if (app->options[WINDOW] > outstanding)
+		outstanding = app->options[WINDOW];
+	app->dup_window = DUP_WINDOW_MIN;
+	while (app->dup_window < 2 * outstanding && app->dup_window < 65536)
+		app->dup_window <<= 1;
+	app->settle_lag = outstanding;
+}
+
+/**
+ * Per target arrays, carved from one arena in a single allocation:
+ *   t_target        hot state, 136 bytes (counters, stats, pointers)
+ *   t_target_info   32 bytes of names
+ *   dup window      dup_window / 8 bytes, 32 by default
+ *   send times      dup_window * 4 bytes, 1 KiB by default
+ *   t_loss_stats    88 bytes, only with --jitter
+ *   t_sketch        2080 bytes, only with --percentiles or --save-sketch
+ * About 1.3 KiB per target by default: 100k targets fit in ~130 MB, and
+ * a pass over the hot array reads nothing but counters.
+ */
+void	targets_alloc(t_ft_ping *app)
+{
+	t_target_info	*info;
+	t_sketch		*sketches;
+	t_loss_stats	*losses;
+	uint8_t			*maps;
+	uint32_t		*times;
+	size_t			n;
+	size_t			i;
+
+	n = app->target_count;
+	targets_dup_window(app);
+	sketches = NULL;
+	losses = NULL;
+	arena_init(&app->arena, arena_size(n * sizeof(t_target))
+		+ arena_size(n * sizeof(t_target_info))
+		+ arena_size(n * app->dup_window / 8)
+		+ arena_size(n * app->dup_window * sizeof(uint32_t))
+		+ (app->options[PERCENTILES] || app->options[SAVE_SKETCH]
+			? arena_size(n * sizeof(t_sketch)) : 0)
+		+ (app->options[JITTER] ? arena_size(n * sizeof(t_loss_stats)) : 0));
+	app->targets = arena_alloc(&app->arena, n * sizeof(t_target));
+	info = arena_alloc(&app->arena, n * sizeof(t_target_info));
+	maps = arena_alloc(&app->arena, n * app->dup_window / 8);
+	times = arena_alloc(&app->arena, n * app->dup_window * sizeof(uint32_t));
+	if (app->options[PERCENTILES] || app->options[SAVE_SKETCH])
+		sketches = arena_alloc(&app->arena, n * sizeof(t_sketch));
+	if (app->options[JITTER])
+		losses = arena_alloc(&app->arena, n * sizeof(t_loss_stats));
+	for (i = 0; i < n; i++)
+	{
+		app->targets[i].info = &info[i];
+		app->targets[i].rcv_map = maps + i * app->dup_window / 8;
+		app->targets[i].send_times = times + i * app->dup_window;
+		if (sketches)
+			app->targets[i].sketch = &sketches[i];
+		if (losses)
+			app->targets[i].loss = &losses[i];
+		app->targets[i].id = (uint16_t)(app->pid + i);
+		info[i].dns_next = -1;
+	}
+}
+
+void	targets_init(t_ft_ping *app)
+{
+	size_t	i;
+
+	targets_alloc(app);
+	for (i = 0; i < app->target_count; i++)
+	{
+		app->targets[i].info->hostname = app->hostnames[i];
+		app->targets[i].state = TARGET_RESOLVING;
+	}
+}
+
+/**
+ * Sequence `seq` goes out at `sent`: its window slot last stood for
+ * seq - window. Only the low 32 bits of the send time are kept, the RTT
+ * is their difference with the receive time modulo 2^32 (good to 71 min).
+ */
+void	target_next_seq(t_ft_ping *app, t_target *target, uint16_t seq,
+		struct timeval sent)
+{
+	target->sequence = seq;
+	bitmap_clear(target->rcv_map, seq & (app->dup_window - 1));
+	target->send_times[seq & (app->dup_window - 1)]
+		= (uint32_t)timeval_usec(sent);
+}
+
+void	target_set_address(t_target *target, struct in_addr addr)
+{
+	memset(&target->dest_addr, 0, sizeof(target->dest_addr));
+	target->dest_addr.sin_family = AF_INET;
+	target->dest_addr.sin_addr = addr;
+	inet_ntop(AF_INET, &addr, target->info->ip_str,
+		sizeof(target->info->ip_str));
+}
+
+/* A target is finished once it failed to resolve or got COUNT replies.
+The run stops when there is nothing left to wait for. */
+void	target_finish(t_ft_ping *app, t_target *target)
+{
+	(void) target;
+	app->finished++;
+	if (app->finished >= app->target_count)
+		app->stop = 1;
+}
+
+/**
+ * Echo ids are handed out as pid + index, so the id points straight at the
+ * target. Past 65536 targets the ids wrap around and the reply's source
+ * address picks between the candidates.
+ */
+t_target	*target_lookup(t_ft_ping *app, uint16_t id, in_addr_t addr)
+{
+	size_t	i;
+
+	i = (uint16_t)(id - app->pid);
+	if (app->target_count <= 65536)
+		return (i < app->target_count ? &app->targets[i] : NULL);
+	for (; i < app->target_count; i += 65536)
+	{
+		if (app->targets[i].dest_addr.sin_addr.s_addr == addr)
+			return (&app->targets[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * Find the target an ICMP error refers to through the echo request embedded
+ * in it (RFC 792: original IP header + first 8 bytes of the datagram).
+ * With a single target every error is reported, like inetutils does.
+ */
+t_target	*target_from_error(t_ft_ping *app, const t_packet *pkt)
+{
+	if (app->target_count == 1)
+		return (&app->targets[0]);
+	if (!pkt->has_orig)
+		return (NULL);
+	return (target_lookup(app, pkt->orig_id, pkt->orig_daddr));
+}
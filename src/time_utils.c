@@ -43,14 +43,16 @@ void	initialize_timing(uint32_t interval_ms, struct timeval *interval,
 	memset(interval, 0, sizeof(*interval));
 	memset(last, 0, sizeof(*last));
 	memset(resp_time, 0, sizeof(*resp_time));
-	if (g_ft_ping->options[FLOOD])
+	if (g_ft_ping->sweep)
+		interval->tv_usec = 1000; // 1 ms, the rate is paced per tick
+	else if (g_ft_ping->options[FLOOD] || g_ft_ping->options[PMTU])
 		interval->tv_usec = 10000; // 10 ms
 	else
 	{
 		interval->tv_sec = interval_ms / 1000;
 		interval->tv_usec = (interval_ms % 1000) * 1000;
 	}
-	gettimeofday(last, NULL);	
+	clock_now(last);	
 }
 
 /* Calculate time remaining until next packet should be sent.
@@ -60,7 +62,7 @@ void	calculate_timeout_remaining(struct timeval *timeout,
 {	
 	struct timeval	now;
 
-	gettimeofday(&now, NULL);
+	clock_now(&now);
 	timeout->tv_sec = last->tv_sec + interval->tv_sec - now.tv_sec;
 	timeout->tv_usec = last->tv_usec + interval->tv_usec - now.tv_usec;
 	normalize_timeval(timeout);
@@ -69,6 +71,12 @@ void	calculate_timeout_remaining(struct timeval *timeout,
 		timeout->tv_sec = timeout->tv_usec = 0;
 }
 
+/* Returns tv as a count of microseconds */
+uint64_t	timeval_usec(struct timeval tv)
+{
+	return ((uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec);
+}
+
 /* Returns the elapsed time in microseconds */
 long long	elapsed_time(struct timeval start, struct timeval end)
 {
@@ -85,7 +93,7 @@ int	ping_timeout(struct timeval *start_time, int timeout)
 	struct timeval	now;
 	long long		elapsed;
 
-	gettimeofday(&now, NULL);
+	clock_now(&now);
 	if (timeout)
 	{
 		elapsed = elapsed_time(*start_time, now) / 1000000; // in seconds
@@ -93,4 +101,20 @@ int	ping_timeout(struct timeval *start_time, int timeout)
 			return (1);
 	}
 	return (0);
-}
\ No newline at end of file
+}
+
+/* Seconds on a clock that never jumps, for cache expiry. The virtual clock
+never does, and DNS answers then expire in simulated time. */
+time_t	monotonic_seconds(void)
+{
+	struct timespec	now;
+	struct timeval	virtual_now;
+
+	if (g_ft_ping && g_ft_ping->options[VIRTUAL_CLOCK])
+	{
+		clock_now(&virtual_now);
+		return (virtual_now.tv_sec);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec);
+}
@@ -0,0 +1,219 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   trace.c                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:19:30 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/18 18:19:30 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+void	trace_init(t_ft_ping *app)
+{
+	app->trace = calloc(1, sizeof(t_trace));
+	if (!app->trace)
+	{
+		perror("ft_ping: trace");
+		exit(1);
+	}
+	app->trace->max_hops = app->options[MAX_HOPS];
+}
+
+/**
+ * One round: an echo request for every TTL at once, each carrying its own
+ * TTL as ancillary data. Once the destination answered, hops past it are
+ * no longer probed.
+ */
+void	trace_send_round(t_ft_ping *app)
+{
+	t_trace			*trace;
+	t_target		*target;
+	t_trace_probe	*probe;
+	char			payload[app->packet_size - ICMP_HEADER_SIZE];
+	int				ttl, last;
+
+	trace = app->trace;
+	target = &app->targets[0];
+	if (app->options[COUNT] && trace->rounds >= app->options[COUNT])
+	{
+		app->stop = 1; // Last round had a full interval to come back
+		return ;
+	}
+	last = trace->dest_ttl ? trace->dest_ttl : trace->max_hops;
+	for (ttl = 1; ttl <= last; ttl++)
+	{
+		target->sequence = trace->next_seq++;
+		prepare_payload(payload, sizeof(payload), NULL);
+		prepare_echo_request_packet(payload, app->sendbuffer,
+			target->sequence, target->id);
+		probe = &trace->probes[target->sequence & (TRACE_SLOTS - 1)];
+		probe->seq = target->sequence;
+		probe->ttl = ttl;
+		clock_now(&probe->sent);
+		if (send_packet_ttl(&app->transport, app->sendbuffer, app->packet_size,
+				&target->dest_addr, ttl) < 0)
+			continue ;
+		trace->hops[ttl - 1].sent++;
+		target->sent_packets++;
+	}
+	trace->rounds++;
+}
+
+void	trace_start(t_ft_ping *app, t_target *target)
+{
+	printf("TRACE %s (%s): %d hops max, %ld data bytes\n", target->info->hostname,
+		target->info->ip_str, app->trace->max_hops,
+		app->packet_size - ICMP_HEADER_SIZE);
+	trace_send_round(app);
+}
+
+static void	trace_hop_add(t_trace_hop *hop, in_addr_t from, long long rtt)
+{
+	double	delta;
+	int		i;
+
+	for (i = 0; i < hop->naddrs && hop->addrs[i] != from; i++)
+		;
+	if (i == hop->naddrs && hop->naddrs < TRACE_ADDRS)
+		hop->addrs[hop->naddrs++] = from; // ECMP: several routers per hop
+	hop->received++;
+	hop->last = rtt;
+	if (hop->received == 1 || rtt < hop->best)
+		hop->best = rtt;
+	if (hop->received == 1 || rtt > hop->worst)
+		hop->worst = rtt;
+	// Welford's algorithm, as in update_stats
+	delta = rtt - hop->avg;
+	hop->avg += delta / hop->received;
+	hop->m2 += delta * (rtt - hop->avg);
+}
+
+/* Returns the TTL the answered probe was sent with, 0 if it isn't ours or
+went past the destination: the first round probes every TTL, and the
+destination answers all those above its own hop too */
+static int	trace_record(t_ft_ping *app, const t_packet *pkt, int reached)
+{
+	t_trace			*trace;
+	t_trace_probe	*probe;
+	long long		rtt;
+	int				ttl;
+
+	trace = app->trace;
+	probe = &trace->probes[pkt->seq & (TRACE_SLOTS - 1)];
+	if (!probe->ttl || probe->seq != pkt->seq)
+		return (0); // Unknown, too old or already answered
+	ttl = probe->ttl;
+	probe->ttl = 0;
+	if (trace->dest_ttl && ttl > trace->dest_ttl)
+		return (0);
+	rtt = elapsed_time(probe->sent, app->end);
+	trace_hop_add(&trace->hops[ttl - 1], pkt->ip->saddr, rtt);
+	app->targets[0].rcv_packets++;
+	if (reached && (!trace->dest_ttl || ttl < trace->dest_ttl))
+		trace->dest_ttl = ttl;
+	if (!app->options[QUIET])
+		printf("%d bytes from %s: hop=%d icmp_seq=%d time=%lld.%03lld ms\n",
+			pkt->len, ip_get_source_addr(pkt->ip), ttl, pkt->seq,
+			rtt / 1000, rtt % 1000);
+	return (ttl);
+}
+
+static char	trace_unreach_flag(uint8_t code)
+{
+	if (code == ICMP_NET_UNREACH)
+		return ('N');
+	if (code == ICMP_HOST_UNREACH)
+		return ('H');
+	if (code == ICMP_PROT_UNREACH)
+		return ('P');
+	if (code == ICMP_FRAG_NEEDED)
+		return ('F');
+	return ('X');
+}
+
+/**
+ * Time Exceeded and Unreachable errors carry our original echo request: its
+ * id tells it's ours, its sequence which probe (hence which TTL) it was.
+ */
+void	trace_process(t_ft_ping *app, const t_packet *pkt)
+{
+	t_target	*target;
+	int			ttl;
+
+	target = &app->targets[0];
+	if (pkt->type == ICMP_ECHOREPLY)
+	{
+		if (pkt->id == target->id)
+			trace_record(app, pkt, 1);
+		return ;
+	}
+	if (pkt->type != ICMP_TIME_EXCEEDED && pkt->type != ICMP_DEST_UNREACH)
+		return ;
+	if (!pkt->has_orig || pkt->orig_id != target->id)
+		return ;
+	ttl = trace_record(app, pkt, pkt->type == ICMP_DEST_UNREACH);
+	if (ttl && pkt->type == ICMP_DEST_UNREACH)
+		app->trace->hops[ttl - 1].flag = trace_unreach_flag(pkt->code);
+	if (ttl && app->options[VERBOSE])
+		print_icmp_error(pkt, app);
+}
+
+static void	print_ms(long long usec)
+{
+	printf(" %4lld.%03lld", usec / 1000, usec % 1000);
+}
+
+/*
+Example:
+--- 10.0.3.2 trace statistics ---
+HOP  ADDRESS                               LOSS%   SNT     LAST      AVG     BEST     WRST    STDEV
+  1  10.0.1.1                               0.0%     5    0.061    0.052    0.041    0.061    0.007
+  2  10.0.2.2                               0.0%     5    0.057    0.061    0.054    0.070    0.006
+*/
+void	trace_report(t_ft_ping *app)
+{
+	t_trace		*trace;
+	t_trace_hop	*hop;
+	int			ttl, last, i;
+	float		loss;
+	char		addr[INET_ADDRSTRLEN];
+
+	trace = app->trace;
+	last = trace->dest_ttl ? trace->dest_ttl : trace->max_hops;
+	// Don't list the silent tail when the destination never answered
+	while (!trace->dest_ttl && last > 1 && !trace->hops[last - 1].received)
+		last--;
+	printf("--- %s trace statistics ---\n", app->targets[0].info->hostname);
+	printf("HOP  %-36s %6s %5s %8s %8s %8s %8s %8s\n", "ADDRESS", "LOSS%",
+		"SNT", "LAST", "AVG", "BEST", "WRST", "STDEV");
+	for (ttl = 1; ttl <= last; ttl++)
+	{
+		hop = &trace->hops[ttl - 1];
+		loss = hop->sent ? 100.0 * (hop->sent - hop->received) / hop->sent : 0;
+		if (!hop->naddrs)
+		{
+			printf("%3d  %-36s %5.1f%% %5d\n", ttl, "???", loss, hop->sent);
+			continue ;
+		}
+		inet_ntop(AF_INET, &hop->addrs[0], addr, sizeof(addr));
+		printf("%3d  %-34s%c%c %5.1f%% %5d", ttl, addr,
+			hop->flag ? '!' : ' ', hop->flag ? hop->flag : ' ',
+			loss, hop->sent);
+		print_ms(hop->last);
+		print_ms((long long)hop->avg);
+		print_ms(hop->best);
+		print_ms(hop->worst);
+		print_ms((long long)sqrt(hop->m2 / hop->received));
+		printf("\n");
+		for (i = 1; i < hop->naddrs; i++)
+		{
+			inet_ntop(AF_INET, &hop->addrs[i], addr, sizeof(addr));
+			printf("     %s\n", addr);
+		}
+	}
+}
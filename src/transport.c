@@ -0,0 +1,158 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   transport.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: tfregni <tfregni@student.42berlin.de>      +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 18:41:16 by tfregni           #+#    #+#             */
+/*   Updated: 2026/10/19 18:41:16 by tfregni          ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+
+#include "ft_ping.h"
+
+/* sendto, or sendmsg with the TTL as IP_TTL ancillary data when ttl is set:
+the TTL then applies to this packet only, the socket wide --ttl stays */
+static int	raw_send(t_transport *transport, const uint8_t *buf, size_t len,
+		const struct sockaddr_in *addr, int ttl)
+{
+	struct msghdr	msg;
+	struct iovec	iov;
+	char			control[CMSG_SPACE(sizeof(int))];
+	struct cmsghdr	*cmsg;
+
+	if (!ttl)
+		return (sendto(transport->fd, buf, len, 0,
+				(const struct sockaddr *)addr, sizeof(*addr)));
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = (void *)buf;
+	iov.iov_len = len;
+	msg.msg_name = (void *)addr;
+	msg.msg_namelen = sizeof(*addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = IPPROTO_IP;
+	cmsg->cmsg_type = IP_TTL;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &ttl, sizeof(ttl));
+	return (sendmsg(transport->fd, &msg, 0));
+}
+
+/* recvmsg, with the SO_TIMESTAMP kernel receive time when there is one */
+static int	raw_recv(t_transport *transport, uint8_t *buf, size_t size,
+		struct sockaddr_in *from, struct timeval *stamp)
+{
+	int				bytes;
+	struct msghdr	msg;
+	struct iovec	iov;
+	char			control[1024];
+	struct cmsghdr	*cmsg;
+
+	memset(from, 0, sizeof(*from));
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	msg.msg_name = from;
+	msg.msg_namelen = sizeof(*from);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	bytes = recvmsg(transport->fd, &msg, 0);
+	if (bytes >= 0 && stamp)
+	{
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP)
+				*stamp = *(struct timeval *)CMSG_DATA(cmsg);
+		}
+	}
+	return (bytes);
+}
+
+static void	raw_close(t_transport *transport)
+{
+	if (transport->fd >= 0)
+		close(transport->fd);
+	transport->fd = -1;
+}
+
+/* Kernel backend over an already configured raw ICMP socket */
+void	transport_raw_init(t_transport *transport, int raw_socket)
+{
+	memset(transport, 0, sizeof(*transport));
+	transport->name = "raw";
+	transport->fd = raw_socket;
+	transport->send = raw_send;
+	transport->recv = raw_recv;
+	transport->close = raw_close;
+}
+
+/* IP_HDRINCL: the header built from the template and the ICMP message go
+out as two iovecs, the message isn't copied. -v dumps both in place. */
+static int	hdrincl_send(t_transport *transport, const uint8_t *buf,
+		size_t len, const struct sockaddr_in *addr, int ttl)
+{
+	t_ip_template	*tmpl;
+	struct msghdr	msg;
+	struct iovec	iov[2];
+	int				bytes;
+
+	tmpl = transport->ctx;
+	ip_template_fill(tmpl, &tmpl->last, len, addr->sin_addr.s_addr, ttl);
+	memset(&msg, 0, sizeof(msg));
+	iov[0].iov_base = &tmpl->last;
+	iov[0].iov_len = sizeof(tmpl->last);
+	iov[1].iov_base = (void *)buf;
+	iov[1].iov_len = len;
+	msg.msg_name = (void *)addr;
+	msg.msg_namelen = sizeof(*addr);
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	bytes = sendmsg(transport->fd, &msg, 0);
+	if (bytes < 0)
+		return (bytes);
+	if (tmpl->dump)
+		datagram_dump(&tmpl->last, sizeof(tmpl->last), buf);
+	return (bytes - sizeof(tmpl->last));
+}
+
+static void	hdrincl_close(t_transport *transport)
+{
+	raw_close(transport);
+	free(transport->ctx);
+	transport->ctx = NULL;
+}
+
+/* Raw backend on an IP_HDRINCL socket, taking ownership of tmpl */
+void	transport_hdrincl_init(t_transport *transport, int raw_socket,
+		t_ip_template *tmpl)
+{
+	transport_raw_init(transport, raw_socket);
+	transport->name = "hdrincl";
+	transport->ctx = tmpl;
+	transport->sent_ip = &tmpl->last;
+	transport->send = hdrincl_send;
+	transport->close = hdrincl_close;
+}
+
+/**
+ * True when a packet can be read right now: the descriptor is readable, or
+ * for backends without one, their next packet is already due.
+ */
+bool	transport_ready(t_transport *transport, fd_set *fdset)
+{
+	struct timeval	delay;
+
+	if (transport->fd >= 0)
+		return (FD_ISSET(transport->fd, fdset));
+	return (transport->next_event && transport->next_event(transport, &delay)
+		&& !timerisset(&delay));
+}